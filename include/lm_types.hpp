@@ -5,13 +5,16 @@
 #include <boost/preprocessor/cat.hpp>
 
 #include "../external/emphf/base_hash.hpp"
+#include "utils/wyhash.hpp"
 #include "utils/mph_tables.hpp"
+#include "utils/cuckoo_table.hpp"
 #include "mph_count_lm.hpp"
 #include "mph_prob_lm.hpp"
 #include "trie_count_lm.hpp"
 #include "trie_prob_lm.hpp"
 #include "mappers.hpp"
 #include "vectors/hash_compact_vector.hpp"
+#include "vectors/cache_line_sorted_array.hpp"
 #include "sequences/ef_sequence.hpp"
 #include "sequences/sequence_collections.hpp"
 #include "sequences/indexed_codewords_sequence.hpp"
@@ -19,23 +22,78 @@
 #include "sequences/fast_ef_sequence.hpp"
 #include "sequences/prefix_summed_sequence.hpp"
 #include "sequences/uniform_pef_sequence.hpp"
+#include "sequences/optimal_pef_sequence.hpp"
 
 namespace tongrams {
 
-#define TONGRAMS_MPH_COUNT_TYPE(HASH_KEY_BITS)                 \
-    mph_count_lm<sequence_collection,                          \
-                 hash_compact_vector<uint##HASH_KEY_BITS##_t>, \
-                 emphf::jenkins##HASH_KEY_BITS##_hasher>
+#define TONGRAMS_MPH_TABLE_TYPE(HASH_KEY_BITS, BASE_HASHER, MPHF)    \
+    single_valued_mpht<hash_compact_vector<uint##HASH_KEY_BITS##_t>, \
+                       BASE_HASHER##HASH_KEY_BITS##_hasher,          \
+                       MPHF<BASE_HASHER##HASH_KEY_BITS##_hasher>>
 
-#define TONGRAMS_MPH_PROB_TYPE(HASH_KEY_BITS)                 \
-    mph_prob_lm<quantized_sequence_collection,                \
-                hash_compact_vector<uint##HASH_KEY_BITS##_t>, \
-                emphf::jenkins##HASH_KEY_BITS##_hasher>
+#define TONGRAMS_MPH_COUNT_TYPE(HASH_KEY_BITS, BASE_HASHER, MPHF) \
+    mph_count_lm<sequence_collection,                           \
+                 TONGRAMS_MPH_TABLE_TYPE(HASH_KEY_BITS, BASE_HASHER, MPHF)>
 
-typedef TONGRAMS_MPH_COUNT_TYPE(32) mph32_count_lm;
-typedef TONGRAMS_MPH_COUNT_TYPE(64) mph64_count_lm;
-typedef TONGRAMS_MPH_PROB_TYPE(32) mph32_prob_lm;
-typedef TONGRAMS_MPH_PROB_TYPE(64) mph64_prob_lm;
+#define TONGRAMS_MPH_PROB_TYPE(HASH_KEY_BITS, BASE_HASHER, MPHF) \
+    mph_prob_lm<quantized_sequence_collection,                 \
+                TONGRAMS_MPH_TABLE_TYPE(HASH_KEY_BITS, BASE_HASHER, MPHF)>
+
+typedef TONGRAMS_MPH_COUNT_TYPE(32, emphf::jenkins, mphf) mph32_count_lm;
+typedef TONGRAMS_MPH_COUNT_TYPE(64, emphf::jenkins, mphf) mph64_count_lm;
+typedef TONGRAMS_MPH_PROB_TYPE(32, emphf::jenkins, mphf) mph32_prob_lm;
+typedef TONGRAMS_MPH_PROB_TYPE(64, emphf::jenkins, mphf) mph64_prob_lm;
+
+// NOTE: same models, hashing with wyhash instead of Jenkins' hash
+typedef TONGRAMS_MPH_COUNT_TYPE(32, wyhash, mphf) mph32_wyhash_count_lm;
+typedef TONGRAMS_MPH_COUNT_TYPE(64, wyhash, mphf) mph64_wyhash_count_lm;
+typedef TONGRAMS_MPH_PROB_TYPE(32, wyhash, mphf) mph32_wyhash_prob_lm;
+typedef TONGRAMS_MPH_PROB_TYPE(64, wyhash, mphf) mph64_wyhash_prob_lm;
+
+// NOTE: single-access PTHash-style functions
+typedef TONGRAMS_MPH_COUNT_TYPE(32, wyhash, pthash_mphf)
+    mph32_wyhash_pthash_count_lm;
+typedef TONGRAMS_MPH_COUNT_TYPE(64, wyhash, pthash_mphf)
+    mph64_wyhash_pthash_count_lm;
+typedef TONGRAMS_MPH_PROB_TYPE(32, wyhash, pthash_mphf)
+    mph32_wyhash_pthash_prob_lm;
+typedef TONGRAMS_MPH_PROB_TYPE(64, wyhash, pthash_mphf)
+    mph64_wyhash_pthash_prob_lm;
+
+// NOTE: open-addressing tables: no hash function to store or
+// query, at the price of the empty slots of the buckets
+#define TONGRAMS_CUCKOO_COUNT_TYPE(HASH_KEY_BITS) \
+    mph_count_lm<sequence_collection,            \
+                 cuckoo_table<wyhash64_hasher, HASH_KEY_BITS>>
+
+#define TONGRAMS_CUCKOO_PROB_TYPE(HASH_KEY_BITS) \
+    mph_prob_lm<quantized_sequence_collection,  \
+                cuckoo_table<wyhash64_hasher, HASH_KEY_BITS>>
+
+typedef TONGRAMS_CUCKOO_COUNT_TYPE(32) cuckoo32_wyhash_count_lm;
+typedef TONGRAMS_CUCKOO_COUNT_TYPE(64) cuckoo64_wyhash_count_lm;
+typedef TONGRAMS_CUCKOO_PROB_TYPE(32) cuckoo32_wyhash_prob_lm;
+typedef TONGRAMS_CUCKOO_PROB_TYPE(64) cuckoo64_wyhash_prob_lm;
+
+// NOTE: tables of order > 1 keyed by the ids of the words
+typedef mph_count_lm<sequence_collection,
+                     TONGRAMS_MPH_TABLE_TYPE(64, wyhash, mphf), true>
+    mph64_wyhash_ids_count_lm;
+typedef mph_count_lm<sequence_collection,
+                     TONGRAMS_MPH_TABLE_TYPE(64, wyhash, pthash_mphf), true>
+    mph64_wyhash_pthash_ids_count_lm;
+typedef mph_count_lm<sequence_collection,
+                     cuckoo_table<wyhash64_hasher, 64>, true>
+    cuckoo64_wyhash_ids_count_lm;
+typedef mph_prob_lm<quantized_sequence_collection,
+                    TONGRAMS_MPH_TABLE_TYPE(64, wyhash, mphf), true>
+    mph64_wyhash_ids_prob_lm;
+typedef mph_prob_lm<quantized_sequence_collection,
+                    TONGRAMS_MPH_TABLE_TYPE(64, wyhash, pthash_mphf), true>
+    mph64_wyhash_pthash_ids_prob_lm;
+typedef mph_prob_lm<quantized_sequence_collection,
+                    cuckoo_table<wyhash64_hasher, 64>, true>
+    cuckoo64_wyhash_ids_prob_lm;
 
 #define TONGRAMS_TRIE_COUNT_TYPE(MAPPER, COUNT_RANKS, GRAM_SEQUENCE_TYPE) \
     trie_count_lm<single_valued_mpht64, MAPPER, sequence_collection,      \
@@ -78,6 +136,25 @@ typedef TONGRAMS_TRIE_COUNT_TYPE(
     sorted_array_mapper, prefix_summed_sequence<pef::uniform_pef_sequence>,
     pef::uniform_pef_sequence) pef_rtrie_PSPEF_ranks_count_lm;
 
+// NOTE: optimally partitioned variants; there is no binary header
+// for them, so they are built and loaded through the template types
+typedef TONGRAMS_TRIE_COUNT_TYPE(identity_mapper, indexed_codewords_sequence,
+                                 pef::optimal_pef_sequence)
+    opef_trie_IC_ranks_count_lm;
+typedef TONGRAMS_TRIE_COUNT_TYPE(
+    sorted_array_mapper, indexed_codewords_sequence,
+    pef::optimal_pef_sequence) opef_rtrie_IC_ranks_count_lm;
+
+// NOTE: the ranks type is not used by the cache-line layout
+typedef TONGRAMS_TRIE_COUNT_TYPE(identity_mapper, indexed_codewords_sequence,
+                                 cache_line_layout) cl_trie_count_lm;
+
+// NOTE: vocabulary hashed with wyhash instead of Jenkins' hash
+typedef trie_count_lm<single_valued_wyhash_mpht64, identity_mapper,
+                      sequence_collection, indexed_codewords_sequence,
+                      fast_ef_sequence, ef_sequence>
+    ef_trie_IC_ranks_wyhash_count_lm;
+
 #define TONGRAMS_TRIE_PROB_TYPE(MAPPER, GRAM_SEQUENCE_TYPE)                   \
     trie_prob_lm<double_valued_mpht64, MAPPER, quantized_sequence_collection, \
                  compact_vector, GRAM_SEQUENCE_TYPE, ef_sequence>
@@ -90,51 +167,93 @@ typedef TONGRAMS_TRIE_PROB_TYPE(sorted_array_mapper,
                                 fast_ef_sequence) ef_rtrie_prob_lm;
 typedef TONGRAMS_TRIE_PROB_TYPE(sorted_array_mapper,
                                 pef::uniform_pef_sequence) pef_rtrie_prob_lm;
+typedef TONGRAMS_TRIE_PROB_TYPE(identity_mapper,
+                                cache_line_layout) cl_trie_prob_lm;
+typedef TONGRAMS_TRIE_PROB_TYPE(identity_mapper,
+                                pef::optimal_pef_sequence) opef_trie_prob_lm;
+
+typedef trie_prob_lm<double_valued_wyhash_mpht64, identity_mapper,
+                     quantized_sequence_collection, compact_vector,
+                     fast_ef_sequence, ef_sequence>
+    ef_trie_wyhash_prob_lm;
 
 // for print_stats.cpp
-#define TONGRAMS_TYPES                                                      \
-    (mph32_count_lm)(mph64_count_lm)(ef_trie_IC_ranks_count_lm)(            \
-        ef_trie_PSEF_ranks_count_lm)(ef_trie_PSPEF_ranks_count_lm)(         \
-        ef_rtrie_IC_ranks_count_lm)(ef_rtrie_PSEF_ranks_count_lm)(          \
-        ef_rtrie_PSPEF_ranks_count_lm)(pef_trie_IC_ranks_count_lm)(         \
-        pef_trie_PSEF_ranks_count_lm)(pef_trie_PSPEF_ranks_count_lm)(       \
-        pef_rtrie_IC_ranks_count_lm)(pef_rtrie_PSEF_ranks_count_lm)(        \
-        pef_rtrie_PSPEF_ranks_count_lm)(ef_trie_prob_lm)(pef_trie_prob_lm)( \
-        ef_rtrie_prob_lm)(pef_rtrie_prob_lm)(mph32_prob_lm)(mph64_prob_lm)
+#define TONGRAMS_TYPES                                                        \
+    (mph32_count_lm)(mph64_count_lm)(ef_trie_IC_ranks_count_lm)(              \
+        ef_trie_PSEF_ranks_count_lm)(ef_trie_PSPEF_ranks_count_lm)(           \
+        ef_rtrie_IC_ranks_count_lm)(ef_rtrie_PSEF_ranks_count_lm)(            \
+        ef_rtrie_PSPEF_ranks_count_lm)(pef_trie_IC_ranks_count_lm)(           \
+        pef_trie_PSEF_ranks_count_lm)(pef_trie_PSPEF_ranks_count_lm)(         \
+        pef_rtrie_IC_ranks_count_lm)(pef_rtrie_PSEF_ranks_count_lm)(          \
+        pef_rtrie_PSPEF_ranks_count_lm)(cl_trie_count_lm)(ef_trie_prob_lm)(   \
+        pef_trie_prob_lm)(ef_rtrie_prob_lm)(pef_rtrie_prob_lm)(               \
+        cl_trie_prob_lm)(mph32_prob_lm)(mph64_prob_lm)(                       \
+        ef_trie_IC_ranks_wyhash_count_lm)(mph32_wyhash_count_lm)(             \
+        mph64_wyhash_count_lm)(ef_trie_wyhash_prob_lm)(mph32_wyhash_prob_lm)( \
+        mph64_wyhash_prob_lm)(mph32_wyhash_pthash_count_lm)(                  \
+        mph64_wyhash_pthash_count_lm)(mph32_wyhash_pthash_prob_lm)(           \
+        mph64_wyhash_pthash_prob_lm)(cuckoo32_wyhash_count_lm)(               \
+        cuckoo64_wyhash_count_lm)(cuckoo32_wyhash_prob_lm)(                   \
+        cuckoo64_wyhash_prob_lm)(mph64_wyhash_ids_count_lm)(                  \
+        mph64_wyhash_pthash_ids_count_lm)(cuckoo64_wyhash_ids_count_lm)(      \
+        mph64_wyhash_ids_prob_lm)(mph64_wyhash_pthash_ids_prob_lm)(           \
+        cuckoo64_wyhash_ids_prob_lm)
 
 // for check_count_model.cpp
 //     lookup_perf_test.cpp
-#define TONGRAMS_COUNT_TYPES                                          \
-    (mph32_count_lm)(mph64_count_lm)(ef_trie_IC_ranks_count_lm)(      \
-        ef_trie_PSEF_ranks_count_lm)(ef_trie_PSPEF_ranks_count_lm)(   \
-        ef_rtrie_IC_ranks_count_lm)(ef_rtrie_PSEF_ranks_count_lm)(    \
-        ef_rtrie_PSPEF_ranks_count_lm)(pef_trie_IC_ranks_count_lm)(   \
-        pef_trie_PSEF_ranks_count_lm)(pef_trie_PSPEF_ranks_count_lm)( \
-        pef_rtrie_IC_ranks_count_lm)(pef_rtrie_PSEF_ranks_count_lm)(  \
-        pef_rtrie_PSPEF_ranks_count_lm)
+#define TONGRAMS_COUNT_TYPES                                            \
+    (mph32_count_lm)(mph64_count_lm)(ef_trie_IC_ranks_count_lm)(        \
+        ef_trie_PSEF_ranks_count_lm)(ef_trie_PSPEF_ranks_count_lm)(     \
+        ef_rtrie_IC_ranks_count_lm)(ef_rtrie_PSEF_ranks_count_lm)(      \
+        ef_rtrie_PSPEF_ranks_count_lm)(pef_trie_IC_ranks_count_lm)(     \
+        pef_trie_PSEF_ranks_count_lm)(pef_trie_PSPEF_ranks_count_lm)(   \
+        pef_rtrie_IC_ranks_count_lm)(pef_rtrie_PSEF_ranks_count_lm)(    \
+        pef_rtrie_PSPEF_ranks_count_lm)(cl_trie_count_lm)(              \
+        ef_trie_IC_ranks_wyhash_count_lm)(mph32_wyhash_count_lm)(       \
+        mph64_wyhash_count_lm)(mph32_wyhash_pthash_count_lm)(           \
+        mph64_wyhash_pthash_count_lm)(cuckoo32_wyhash_count_lm)(        \
+        cuckoo64_wyhash_count_lm)(mph64_wyhash_ids_count_lm)(           \
+        mph64_wyhash_pthash_ids_count_lm)(cuckoo64_wyhash_ids_count_lm)
 
 // for build_mph_lm.cpp
-#define TONGRAMS_HASH_COUNT_TYPES (mph32_count_lm)(mph64_count_lm)
+#define TONGRAMS_HASH_COUNT_TYPES                                       \
+    (mph32_count_lm)(mph64_count_lm)(mph32_wyhash_count_lm)(            \
+        mph64_wyhash_count_lm)(mph32_wyhash_pthash_count_lm)(           \
+        mph64_wyhash_pthash_count_lm)(cuckoo32_wyhash_count_lm)(        \
+        cuckoo64_wyhash_count_lm)(mph64_wyhash_ids_count_lm)(           \
+        mph64_wyhash_pthash_ids_count_lm)(cuckoo64_wyhash_ids_count_lm)
 
 // for build_mph_lm.cpp
-#define TONGRAMS_HASH_PROB_TYPES (mph32_prob_lm)(mph64_prob_lm)
+#define TONGRAMS_HASH_PROB_TYPES                                      \
+    (mph32_prob_lm)(mph64_prob_lm)(mph32_wyhash_prob_lm)(             \
+        mph64_wyhash_prob_lm)(mph32_wyhash_pthash_prob_lm)(           \
+        mph64_wyhash_pthash_prob_lm)(cuckoo32_wyhash_prob_lm)(        \
+        cuckoo64_wyhash_prob_lm)(mph64_wyhash_ids_prob_lm)(           \
+        mph64_wyhash_pthash_ids_prob_lm)(cuckoo64_wyhash_ids_prob_lm)
 
 // for build_trie_lm.cpp
-#define TONGRAMS_TRIE_COUNT_TYPES                                     \
-    (ef_trie_IC_ranks_count_lm)(ef_trie_PSEF_ranks_count_lm)(         \
-        ef_trie_PSPEF_ranks_count_lm)(ef_rtrie_IC_ranks_count_lm)(    \
-        ef_rtrie_PSEF_ranks_count_lm)(ef_rtrie_PSPEF_ranks_count_lm)( \
-        pef_trie_IC_ranks_count_lm)(pef_trie_PSEF_ranks_count_lm)(    \
-        pef_trie_PSPEF_ranks_count_lm)(pef_rtrie_IC_ranks_count_lm)(  \
-        pef_rtrie_PSEF_ranks_count_lm)(pef_rtrie_PSPEF_ranks_count_lm)
+#define TONGRAMS_TRIE_COUNT_TYPES                                       \
+    (ef_trie_IC_ranks_count_lm)(ef_trie_PSEF_ranks_count_lm)(           \
+        ef_trie_PSPEF_ranks_count_lm)(ef_rtrie_IC_ranks_count_lm)(      \
+        ef_rtrie_PSEF_ranks_count_lm)(ef_rtrie_PSPEF_ranks_count_lm)(   \
+        pef_trie_IC_ranks_count_lm)(pef_trie_PSEF_ranks_count_lm)(      \
+        pef_trie_PSPEF_ranks_count_lm)(pef_rtrie_IC_ranks_count_lm)(    \
+        pef_rtrie_PSEF_ranks_count_lm)(pef_rtrie_PSPEF_ranks_count_lm)( \
+        cl_trie_count_lm)(ef_trie_IC_ranks_wyhash_count_lm)
 
 // for build_trie_lm.cpp
-#define TONGRAMS_TRIE_PROB_TYPES \
-    (ef_trie_prob_lm)(pef_trie_prob_lm)(ef_rtrie_prob_lm)(pef_rtrie_prob_lm)
+#define TONGRAMS_TRIE_PROB_TYPES                                              \
+    (ef_trie_prob_lm)(pef_trie_prob_lm)(ef_rtrie_prob_lm)(pef_rtrie_prob_lm)( \
+        cl_trie_prob_lm)(ef_trie_wyhash_prob_lm)
 
 // for score.cpp
 #define TONGRAMS_SCORE_TYPES                                                  \
     (ef_trie_prob_lm)(pef_trie_prob_lm)(ef_rtrie_prob_lm)(pef_rtrie_prob_lm)( \
-        mph32_prob_lm)(mph64_prob_lm)
+        cl_trie_prob_lm)(mph32_prob_lm)(mph64_prob_lm)(                       \
+        ef_trie_wyhash_prob_lm)(mph32_wyhash_prob_lm)(mph64_wyhash_prob_lm)(  \
+        mph32_wyhash_pthash_prob_lm)(mph64_wyhash_pthash_prob_lm)(            \
+        cuckoo32_wyhash_prob_lm)(cuckoo64_wyhash_prob_lm)(                    \
+        mph64_wyhash_ids_prob_lm)(mph64_wyhash_pthash_ids_prob_lm)(           \
+        cuckoo64_wyhash_ids_prob_lm)
 
 }  // namespace tongrams
\ No newline at end of file
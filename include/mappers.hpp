@@ -40,6 +40,11 @@ struct identity_mapper {
                     break;
                 }
 
+                // more than max_order words
+                if (order == global::max_order - 1) {
+                    return global::not_found;
+                }
+
                 byte_range br(prev_pos, pos);
                 uint64_t id = vocab->lookup(br, adaptor);
                 if (id == global::not_found) {
@@ -140,7 +145,7 @@ struct sorted_array_mapper {
         uint64_t order = 0;  // order minus 1
 
         // parent_ids are NOT remapped
-        static uint64_t parent_ids[global::max_order];
+        uint64_t parent_ids[global::max_order];
 
         for (; pos != range.second; ++pos) {
             // assume words separated by whitespaces
@@ -168,6 +173,10 @@ struct sorted_array_mapper {
 
                     for (; pos != range.second; ++pos) {
                         if (*pos == ' ') {
+                            // more than max_order words
+                            if (order == global::max_order - 1) {
+                                return global::not_found;
+                            }
                             uint64_t mapped_id = 0;
                             byte_range br(prev_pos, pos);
                             uint64_t id = vocab->lookup(br, adaptor);
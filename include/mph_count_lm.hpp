@@ -5,16 +5,27 @@
 #include "utils/mph_tables.hpp"
 #include "utils/parsers.hpp"
 #include "utils/util.hpp"
+#include "utils/bloom_filter.hpp"
+#include "utils/word_ids.hpp"
 
 namespace tongrams {
 
-template <typename Values, typename KeyRankSequence, typename BaseHasher>
+// NOTE: with IdKeys, the table of order 1 maps the words to their ids
+// and the tables of higher order are keyed by tuples of word ids
+template <typename Values, typename HashTable, bool IdKeys = false>
 struct mph_count_lm {
-    typedef single_valued_mpht<KeyRankSequence, BaseHasher> hash_table_type;
+    typedef HashTable hash_table_type;
 
     mph_count_lm() : m_order(0) {}
 
-    mph_count_lm(const char* input_dir, uint8_t order) : m_order(order) {
+    // NOTE: the tables of order > 1 keep key_width bits of hash per gram.
+    // If filter_bits > 0, a Bloom filter with filter_bits bits per n-gram
+    // is built for each order, so that most of the n-grams not in the
+    // model are rejected before its tables are accessed.
+    mph_count_lm(const char* input_dir, uint8_t order,
+                 uint64_t key_width = hash_table_type::hash_bits,
+                 uint64_t filter_bits = 0)
+        : m_order(order) {
         building_util::check_order(m_order);
         m_tables.reserve(m_order);
 
@@ -31,9 +42,7 @@ struct mph_count_lm {
 
             essentials::logger("Reading " + std::to_string(ord) +
                                "-grams counts");
-            for (auto const& l : gp) {
-                counts_builder.eat_value(l.count);
-            }
+            eat_counts(filename, gp, counts_builder);
 
             counts_builder.build_sequence();
         }
@@ -59,9 +68,47 @@ struct mph_count_lm {
                 counts_ranks_cvb.push_back(rank);
             }
 
+            if (filter_bits) {
+                blocked_bloom_filter::builder filter_builder(n, filter_bits);
+                for (auto const& br : byte_ranges) filter_builder.add(br);
+                m_filters.push_back(filter_builder);
+            }
+
+            if constexpr (IdKeys) {
+                if (ord == 1) {
+                    // the i-th word gets id i
+                    m_unigrams.build(counts_ranks_cvb);
+                    compact_vector::builder ids_cvb(n, util::ceil_log2(n + 1));
+                    for (uint64_t i = 0; i != n; ++i) ids_cvb.push_back(i);
+                    typename hash_table_type::builder builder(
+                        byte_ranges, compact_vector(ids_cvb),
+                        identity_adaptor());
+                    m_tables.emplace_back(builder);
+                    continue;
+                }
+
+                std::vector<word_id> ids(n * ord);
+                for (uint64_t i = 0; i != n; ++i) {
+                    word_id* gram_ids = &ids[i * ord];
+                    if (word_ids::map(byte_ranges[i], m_tables.front(),
+                                      gram_ids) != uint64_t(ord - 1)) {
+                        throw std::runtime_error(
+                            "n-gram with words not in the 1-grams");
+                    }
+                    byte_ranges[i] = word_ids::bytes(gram_ids, gram_ids + ord);
+                }
+
+                typename hash_table_type::builder builder(
+                    byte_ranges, compact_vector(counts_ranks_cvb),
+                    identity_adaptor(), key_width);
+                m_tables.emplace_back(builder);
+                continue;
+            }
+
             typename hash_table_type::builder builder(
                 byte_ranges, compact_vector(counts_ranks_cvb),
-                identity_adaptor());
+                identity_adaptor(),
+                ord != 1 ? key_width : hash_table_type::hash_bits);
             m_tables.emplace_back(builder);
         }
 
@@ -71,9 +118,26 @@ struct mph_count_lm {
     template <typename T, typename Adaptor>
     uint64_t lookup(T gram, Adaptor adaptor) const {
         byte_range br = adaptor(gram);
-        auto order = std::count(br.first, br.second, ' ');  // order minus 1
-        assert(order < m_order);
+        if (!m_filters.empty() and !m_filters.contains(br)) {
+            return global::not_found;
+        }
+        if constexpr (IdKeys) {
+            word_id ids[global::max_order];
+            uint64_t order = word_ids::map(br, m_tables.front(), ids);
+            if (order == global::not_found or order >= m_order) {
+                return global::not_found;
+            }
+            uint64_t rank = order ? m_tables[order].lookup(
+                                        word_ids::bytes(ids, ids + order + 1),
+                                        identity_adaptor())
+                                  : m_unigrams[ids[0]];
+            if (rank == global::not_found) return global::not_found;
+            return m_distinct_counts.access(order, rank);
+        }
+        uint64_t order = std::count(br.first, br.second, ' ');  // order minus 1
+        if (order >= m_order) return global::not_found;
         uint64_t rank = m_tables[order].lookup(gram, adaptor);
+        if (rank == global::not_found) return global::not_found;
         return m_distinct_counts.access(order, rank);
     }
 
@@ -83,6 +147,16 @@ struct mph_count_lm {
         return uint64_t(m_order);
     }
 
+    // NOTE: the highest probability that a gram not in the model is
+    // reported as found, i.e., that it matches a stored fingerprint
+    double false_positive_rate() const {
+        double rate = 0.0;
+        for (auto const& t : m_tables) {
+            rate = std::max(rate, t.false_positive_rate());
+        }
+        return rate;
+    }
+
     size_t size() const {
         size_t size = 0;
         for (auto const& t : m_tables) {
@@ -94,24 +168,34 @@ struct mph_count_lm {
     void save(std::ostream& os) const {
         essentials::save_pod(os, m_order);
         m_distinct_counts.save(os);
+        if constexpr (IdKeys) m_unigrams.save(os);
+        m_filters.save(os);
         for (auto const& t : m_tables) {
             t.save(os);
         }
     }
 
-    void load(std::istream& is) {
+    // NOTE: the tables of order > max_order are not read, and the
+    // grams of such orders are then reported as not found
+    void load(std::istream& is, uint64_t max_order = global::max_order) {
         essentials::load_pod(is, m_order);
         m_distinct_counts.load(is, m_order);
+        if constexpr (IdKeys) m_unigrams.load(is);
+        m_filters.load(is);
+        m_order = std::min<uint64_t>(m_order, max_order);
+        m_filters.truncate(m_order);
         m_tables.resize(m_order);
-        for (auto& t : m_tables) {
-            t.load(is);
-        }
+        memory::load_sections(
+            is, m_tables.begin(), m_tables.end(),
+            [](std::istream& is, hash_table_type& t, uint64_t) { t.load(is); });
     }
 
 private:
     uint8_t m_order;
     Values m_distinct_counts;
+    compact_vector m_unigrams;  // counts ranks of the words, by id
     std::vector<hash_table_type> m_tables;
+    ngram_filters m_filters;
 };
 
 }  // namespace tongrams
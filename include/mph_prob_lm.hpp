@@ -6,19 +6,24 @@
 #include "utils/iterators.hpp"
 #include "state.hpp"
 #include "utils/util.hpp"
+#include "utils/word_ids.hpp"
 
 namespace tongrams {
 
-template <typename Values, typename KeyRankSequence, typename BaseHasher>
+// NOTE: with IdKeys, the table of order 1 maps the words to their ids
+// and the tables of higher order are keyed by tuples of word ids
+template <typename Values, typename HashTable, bool IdKeys = false>
 struct mph_prob_lm {
-    typedef single_valued_mpht<KeyRankSequence, BaseHasher> hash_table;
+    typedef HashTable hash_table;
 
     struct builder {
-        builder() {}
+        builder() : m_order(0), m_unk_prob(0.0) {}
 
+        // NOTE: the tables of order > 1 keep key_width bits of hash per gram
         builder(const char* arpa_filename, uint8_t order, float unk_prob,
                 uint8_t probs_quantization_bits,
-                uint8_t backoffs_quantization_bits)
+                uint8_t backoffs_quantization_bits,
+                uint64_t key_width = hash_table::hash_bits)
             : m_arpa_filename(arpa_filename)
             , m_order(order)
             , m_unk_prob(unk_prob) {
@@ -86,8 +91,20 @@ struct mph_prob_lm {
                     n, probs_quantization_bits +
                            (ord != m_order ? backoffs_quantization_bits : 0));
 
+                std::vector<word_id> ids(IdKeys ? n * ord : 0);
                 for (auto const& record : pool_index) {
-                    bytes.push_back(record.gram);
+                    if constexpr (IdKeys) {
+                        word_id* gram_ids = &ids[bytes.size() * ord];
+                        if (word_ids::map(record.gram, m_vocab, gram_ids) !=
+                            uint64_t(ord - 1)) {
+                            throw std::runtime_error(
+                                "n-gram with words not in the 1-grams");
+                        }
+                        bytes.push_back(
+                            word_ids::bytes(gram_ids, gram_ids + ord));
+                    } else {
+                        bytes.push_back(record.gram);
+                    }
                     float prob = record.prob;
                     float backoff = record.backoff;
                     // store interleaved ranks
@@ -102,7 +119,7 @@ struct mph_prob_lm {
                 }
 
                 m_tables.emplace_back(bytes, compact_vector(cvb),
-                                      identity_adaptor());
+                                      identity_adaptor(), key_width);
             }
 
             probs_builder.build(m_probs_averages);
@@ -115,9 +132,13 @@ struct mph_prob_lm {
             mph.m_probs_averages.swap(m_probs_averages);
             mph.m_backoffs_averages.swap(m_backoffs_averages);
             mph.m_tables.resize(m_order);
-            for (uint8_t i = 0; i < m_order; ++i) {
+            for (uint8_t i = IdKeys; i < m_order; ++i) {
                 m_tables[i].build(mph.m_tables[i]);
             }
+            if constexpr (IdKeys) {
+                mph.m_tables.front().swap(m_vocab);
+                mph.m_unigrams.swap(m_unigrams);
+            }
             builder().swap(*this);
         }
 
@@ -127,6 +148,8 @@ struct mph_prob_lm {
             m_probs_averages.swap(other.m_probs_averages);
             m_backoffs_averages.swap(other.m_backoffs_averages);
             m_tables.swap(other.m_tables);
+            m_vocab.swap(other.m_vocab);
+            m_unigrams.swap(other.m_unigrams);
         }
 
     private:
@@ -136,6 +159,8 @@ struct mph_prob_lm {
         Values m_probs_averages;
         Values m_backoffs_averages;
         std::vector<typename hash_table::builder> m_tables;
+        hash_table m_vocab;         // built upfront with IdKeys
+        compact_vector m_unigrams;  // packed values of the words, by id
 
         void build_vocabulary(uint64_t unigrams_arpa_offset) {
             arpa_iterator it(m_arpa_filename, 1, unigrams_arpa_offset);
@@ -174,6 +199,18 @@ struct mph_prob_lm {
                 values_cvb.push_back(packed);
             }
 
+            if constexpr (IdKeys) {
+                // the i-th word gets id i
+                m_unigrams.build(values_cvb);
+                compact_vector::builder ids_cvb(n, util::ceil_log2(n + 1));
+                for (uint64_t i = 0; i != n; ++i) ids_cvb.push_back(i);
+                typename hash_table::builder vocab_builder(
+                    bytes, compact_vector(ids_cvb), identity_adaptor());
+                vocab_builder.build(m_vocab);
+                m_tables.emplace_back();  // replaced by m_vocab
+                return;
+            }
+
             m_tables.emplace_back(bytes, compact_vector(values_cvb),
                                   identity_adaptor());
         }
@@ -181,15 +218,40 @@ struct mph_prob_lm {
 
     mph_prob_lm() : m_order(0), m_unk_prob(global::default_unk_prob) {}
 
-    typedef prob_model_state<uint8_t const*> state_type;
+    // NOTE: the state keeps word ids with IdKeys, so that every word
+    // is looked up in the vocabulary once
+    typedef typename std::conditional<IdKeys, uint64_t, uint8_t const*>::type
+        state_word_type;
+    typedef prob_model_state<state_word_type> state_type;
 
     state_type state() {
         return state_type(order());
     }
 
-    float score(state_type& state, byte_range const word, bool& is_OOV) {
+    // NOTE: a state for Order == order() selects the score()
+    // specialized for the order of the model
+    template <uint64_t Order>
+    prob_model_state<state_word_type, Order> state() {
+        assert(Order == order());
+        return prob_model_state<state_word_type, Order>(order());
+    }
+
+    template <uint64_t Order>
+    float score(prob_model_state<state_word_type, Order>& state,
+                byte_range const word, bool& is_OOV) {
+        // a constant if the state is specialized for the order
+        uint64_t const n = Order ? Order : order();
         uint64_t value = m_tables[0].lookup(word, identity_adaptor());
-        state.add_word(word.first);  // save beginning of word
+        word_id ids[global::max_order];  // ids of the gram, right-aligned
+        if constexpr (IdKeys) {
+            state.add_word(value);
+            if (value != global::not_found) {
+                ids[global::max_order - 1] = value;
+                value = m_unigrams.get<64>(value);  // not quantized
+            }
+        } else {
+            state.add_word(word.first);  // save beginning of word
+        }
 
         uint8_t longest_matching_history_len = 0;
         uint64_t order_m1 = 1;
@@ -205,14 +267,23 @@ struct mph_prob_lm {
                 longest_matching_history_len = 1;
             }
 
-            auto words_rbegin = state.words.rbegin();
-            ++words_rbegin;  // skip just added word
-
-            for (; order_m1 <= state.length; ++order_m1, ++words_rbegin) {
+            // NOTE: state.length < n, so the loop runs for at most n - 1
+            // iterations: a bound known at compile time if Order != 0
+            for (; order_m1 != n; ++order_m1) {
+                if (order_m1 > state.length) break;
                 state.advance();
 
-                auto prev_word_begin = *words_rbegin;
-                byte_range gram(prev_word_begin, word.second);
+                byte_range gram;
+                if constexpr (IdKeys) {
+                    uint64_t prev_word_id = state.word(order_m1);
+                    if (prev_word_id == global::not_found) break;
+                    word_id* begin = ids + global::max_order - 1 - order_m1;
+                    *begin = prev_word_id;
+                    gram = word_ids::bytes(begin, ids + global::max_order);
+                } else {
+                    auto prev_word_begin = state.word(order_m1);
+                    gram = byte_range(prev_word_begin, word.second);
+                }
 
                 uint64_t rank =
                     m_tables[order_m1].lookup(gram, identity_adaptor());
@@ -220,7 +291,7 @@ struct mph_prob_lm {
                     break;
                 }
 
-                if (order_m1 != order() - 1) {
+                if (order_m1 != n - 1) {
                     uint64_t probs_quantization_bits =
                         m_probs_averages.quantization_bits(order_m1 - 1);
                     uint64_t mask =
@@ -248,7 +319,8 @@ struct mph_prob_lm {
         }
 
         // if we encountered unseen ngrams during STEP (1)
-        for (uint64_t i = order_m1 - 1; i < state.length; ++i) {
+        for (uint64_t i = order_m1 - 1; i != n - 1; ++i) {
+            if (i >= state.length) break;
             prob += state.backoff(i);
         }
 
@@ -277,6 +349,7 @@ struct mph_prob_lm {
         essentials::save_pod(os, m_unk_prob);
         m_probs_averages.save(os);
         m_backoffs_averages.save(os);
+        if constexpr (IdKeys) m_unigrams.save(os);
         for (auto const& t : m_tables) {
             t.save(os);
         }
@@ -287,10 +360,12 @@ struct mph_prob_lm {
         essentials::load_pod(is, m_unk_prob);
         m_probs_averages.load(is, m_order - 1);
         m_backoffs_averages.load(is, m_order - 2);
+        if constexpr (IdKeys) m_unigrams.load(is);
         m_tables.resize(m_order);
-        for (auto& t : m_tables) {
-            t.load(is);
-        }
+        memory::load_sections(is, m_tables.begin(), m_tables.end(),
+                              [](std::istream& is, hash_table& t, uint64_t) {
+                                  t.load(is);
+                              });
     }
 
 private:
@@ -298,6 +373,7 @@ private:
     float m_unk_prob;
     Values m_probs_averages;
     Values m_backoffs_averages;
+    compact_vector m_unigrams;  // packed values of the words, by id
     std::vector<hash_table> m_tables;
 };
 }  // namespace tongrams
@@ -7,17 +7,43 @@ namespace tongrams {
 
 template <typename Vocabulary, typename Mapper, typename Values, typename Ranks,
           typename Grams, typename Pointers>
+template <uint64_t Order>
 float trie_prob_lm<Vocabulary, Mapper, Values, Ranks, Grams, Pointers>::score(
-    state_type& state, byte_range const word, bool& is_OOV) {
-    uint64_pair word_id = m_vocab.lookup_pair(word, identity_adaptor());
+    prob_model_state<uint64_t, Order>& state, byte_range const word,
+    bool& is_OOV) {
+    // a constant if the state is specialized for the order
+    uint64_t const n = Order ? Order : order();
+    auto& caches = local_caches();
+    uint64_pair word_id = caches.words.lookup(word, [&](byte_range w) {
+        return m_vocab.lookup_pair(w, identity_adaptor());
+    });
     state.add_word(word_id.first);
 
     uint8_t longest_matching_history_len = 0;
     uint64_t order_m1 = 1;
     float prob = 0.0;
 
+    uint64_t key = 0;
+    score_entry entry;
+    bool cached = false;
+    if (m_cache and word_id.first != global::not_found) {
+        key = context_key([&](uint64_t i) { return state.word(i); },
+                          std::min<uint64_t>(state.length, n - 1));
+        cached = m_cache->find(key, entry);
+    }
+
     // STEP (1): determine longest matching history
-    if (word_id.first != global::not_found) {
+    if (cached) {
+        prob = entry.prob;
+        order_m1 = entry.order_m1;
+        longest_matching_history_len = entry.history_len;
+        // the backoffs added to the state, in the same positions
+        state.add_backoff(entry.backoffs[0]);
+        for (uint64_t i = 1; i < std::min<uint64_t>(order_m1, n - 1); ++i) {
+            state.advance();
+            state.add_backoff(entry.backoffs[i]);
+        }
+    } else if (word_id.first != global::not_found) {
         float backoff;
         bits::unpack(word_id.second, prob, backoff);
         state.add_backoff(backoff);
@@ -26,16 +52,17 @@ float trie_prob_lm<Vocabulary, Mapper, Values, Ranks, Grams, Pointers>::score(
             longest_matching_history_len = 1;
         }
 
-        auto words_rbegin = state.words.rbegin();
-        ++words_rbegin;  // skip just added word id
-
         // needed for remapping
         uint64_t prev_id = word_id.first;
         uint64_t prev_prev_id = prev_id;
 
         auto r = m_arrays[0].range(word_id.first);
+        uint64_t context = word_id.first;  // key of the context searched
 
-        for (; order_m1 <= state.length; ++order_m1, ++words_rbegin) {
+        // NOTE: state.length < n, so the loop runs for at most n - 1
+        // iterations: a bound known at compile time if Order != 0
+        for (; order_m1 != n; ++order_m1) {
+            if (order_m1 > state.length) break;
             state.advance();
 
             if (r.end - r.begin == 0) {
@@ -44,44 +71,51 @@ float trie_prob_lm<Vocabulary, Mapper, Values, Ranks, Grams, Pointers>::score(
                 break;
             }
 
-            uint64_t id = *words_rbegin;
-
-            if (Mapper::context_remapping && order_m1 > m_remapping_order) {
-                id = m_mapper.map_id(
-                    prev_id,
-                    prev_prev_id,  // pass the two parent ids for remapping
-                    id, &m_arrays.front(), m_remapping_order);
-            }
-
-            uint64_t pos = m_arrays[order_m1].position(r, id);
-            if (pos == global::not_found) {
+            uint64_t id = state.word(order_m1);
+            bool last = order_m1 == n - 1;
+
+            // NOTE: the searches of the lowest orders are memoized
+            // per thread, but the one of the last order
+            if (order_m1 <= context_cache::max_order_m1 and !last) {
+                context = context_cache::extend(context, id);
+                auto& e = caches.contexts.slot(context);
+                if (e.key != context) {
+                    e.key = context;
+                    e.range = r;
+                    e.found = search(order_m1, id, prev_id, prev_prev_id,
+                                     false, e.range, e.prob, e.backoff);
+                }
+                if (!e.found) break;
+                prob = e.prob;
+                backoff = e.backoff;
+                r = e.range;
+            } else if (!search(order_m1, id, prev_id, prev_prev_id, last, r,
+                               prob, backoff)) {
                 break;
             }
 
-            uint64_t probs_quantization_bits =
-                m_probs_averages.quantization_bits(order_m1 - 1);
-            uint64_t mask = (uint64_t(1) << probs_quantization_bits) - 1;
-            uint64_t prob_backoff_rank =
-                m_arrays[order_m1].prob_backoff_rank(pos);
-            uint64_t prob_rank = prob_backoff_rank & mask;
-            uint64_t backoff_rank =
-                prob_backoff_rank >> probs_quantization_bits;
-            prob = m_probs_averages.access(order_m1 - 1, prob_rank);
-
-            if (order_m1 != order() - 1) {
-                backoff =
-                    m_backoffs_averages.access(order_m1 - 1, backoff_rank);
+            if (!last) {
                 state.add_backoff(backoff);
-                r = m_arrays[order_m1].range(pos);
                 if (backoff) {
                     longest_matching_history_len = order_m1 + 1;
                 }
             }
 
             prev_prev_id = prev_id;
-            prev_id = *words_rbegin;
+            prev_id = id;
         }
 
+        if (m_cache) {
+            entry.prob = prob;
+            entry.order_m1 = order_m1;
+            entry.history_len = longest_matching_history_len;
+            uint64_t num_backoffs = std::max<uint64_t>(
+                1, std::min<uint64_t>(order_m1, n - 1));
+            for (uint64_t i = 0; i != num_backoffs; ++i) {
+                entry.backoffs[i] = state.added_backoff(i);
+            }
+            m_cache->insert(key, entry);
+        }
     } else {  // unseen word
         ++state.OOVs;
         is_OOV = true;
@@ -91,7 +125,8 @@ float trie_prob_lm<Vocabulary, Mapper, Values, Ranks, Grams, Pointers>::score(
 
     // STEP (2): add backoff weights
     // if we encountered unseen ngrams during STEP (1)
-    for (uint64_t i = order_m1 - 1; i < state.length; ++i) {
+    for (uint64_t i = order_m1 - 1; i != n - 1; ++i) {
+        if (i >= state.length) break;
         prob += state.backoff(i);
     }
 
@@ -101,4 +136,103 @@ float trie_prob_lm<Vocabulary, Mapper, Values, Ranks, Grams, Pointers>::score(
     return prob;
 }
 
+template <typename Vocabulary, typename Mapper, typename Values, typename Ranks,
+          typename Grams, typename Pointers>
+float trie_prob_lm<Vocabulary, Mapper, Values, Ranks, Grams, Pointers>::score(
+    decoder_state const& in, uint64_pair const word, decoder_state& out) {
+    assert(&in != &out);
+    uint64_t const n = order();
+    uint64_t const length = std::min<uint64_t>(in.length, n - 1);
+
+    uint8_t longest_matching_history_len = 0;
+    uint64_t order_m1 = 1;
+    float prob = 0.0;
+
+    // NOTE: as for the other score(), the outcome of STEP (1) only depends
+    // on the word and its history, so the two share the entries of a cache
+    uint64_t key = 0;
+    score_entry entry;
+    bool cached = false;
+    if (m_cache and word.first != global::not_found) {
+        key = context_key(
+            [&](uint64_t i) { return i ? in.words[i - 1] : word.first; },
+            length);
+        cached = m_cache->find(key, entry);
+    }
+
+    // STEP (1): determine longest matching history
+    if (cached) {
+        prob = entry.prob;
+        order_m1 = entry.order_m1;
+        longest_matching_history_len = entry.history_len;
+        std::copy(entry.backoffs, entry.backoffs + longest_matching_history_len,
+                  out.backoffs);
+    } else if (word.first != global::not_found) {
+        float backoff;
+        bits::unpack(word.second, prob, backoff);
+        out.backoffs[0] = backoff;
+
+        if (backoff) {
+            longest_matching_history_len = 1;
+        }
+
+        // needed for remapping
+        uint64_t prev_id = word.first;
+        uint64_t prev_prev_id = prev_id;
+
+        auto r = m_arrays[0].range(word.first);
+        for (; order_m1 <= length; ++order_m1) {
+            if (r.end - r.begin == 0) {
+                // no extension to the left, i.e.,
+                // no successors in reversed trie
+                break;
+            }
+
+            uint64_t id = in.words[order_m1 - 1];
+            bool last = order_m1 == n - 1;
+            if (!search(order_m1, id, prev_id, prev_prev_id, last, r, prob,
+                        backoff)) {
+                break;
+            }
+
+            if (!last) {
+                out.backoffs[order_m1] = backoff;
+                if (backoff) {
+                    longest_matching_history_len = order_m1 + 1;
+                }
+            }
+
+            prev_prev_id = prev_id;
+            prev_id = id;
+        }
+
+        if (m_cache) {
+            entry.prob = prob;
+            entry.order_m1 = order_m1;
+            entry.history_len = longest_matching_history_len;
+            uint64_t num_backoffs = std::max<uint64_t>(
+                1, std::min<uint64_t>(order_m1, n - 1));
+            std::copy(out.backoffs, out.backoffs + num_backoffs,
+                      entry.backoffs);
+            m_cache->insert(key, entry);
+        }
+    } else {  // unseen word
+        prob = m_unk_prob;
+    }
+
+    // STEP (2): add backoff weights
+    // if we encountered unseen ngrams during STEP (1)
+    for (uint64_t i = order_m1 - 1; i < length; ++i) {
+        prob += in.backoffs[i];
+    }
+
+    // the history of word is word followed by that of in, truncated
+    out.length = longest_matching_history_len;
+    if (out.length) out.words[0] = word.first;
+    std::copy(in.words, in.words + std::max<int>(out.length - 1, 0),
+              out.words + 1);
+    assert(prob < 0.0);
+    return prob;
+}
+
 }  // namespace tongrams
\ No newline at end of file
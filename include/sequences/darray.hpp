@@ -1,7 +1,10 @@
 #pragma once
 
+#include <thread>
+
 #include "vectors/bit_vector.hpp"
 #include "utils/util.hpp"
+#include "utils/memory.hpp"
 
 namespace tongrams {
 namespace detail {
@@ -10,40 +13,60 @@ template <typename WordGetter>
 struct darray {
     darray() : m_positions() {}
 
-    darray(bit_vector const& bv) : m_positions() {
+    // NOTE:
+    // the bit vector is split into num_threads chunks of words.
+    // After counting the ones of each chunk, every thread builds
+    // the inventories of the blocks starting within its chunk;
+    // these are then concatenated in order.
+    darray(bit_vector const& bv, uint64_t num_threads = default_num_threads())
+        : m_positions() {
         std::vector<uint64_t> const& data = bv.data();
-        std::vector<uint64_t> cur_block_positions;
-        std::vector<int64_t> block_inventory;
-        std::vector<uint16_t> subblock_inventory;
-        std::vector<uint64_t> overflow_positions;
+        num_threads = std::max<uint64_t>(
+            1, std::min<uint64_t>(num_threads,
+                                  data.size() / min_words_per_thread));
 
-        for (size_t word_idx = 0; word_idx < data.size(); ++word_idx) {
-            size_t cur_pos = word_idx << 6;
-            uint64_t cur_word = WordGetter()(data, word_idx);
-            unsigned long l;
-            while (util::lsb(cur_word, l)) {
-                cur_pos += l;
-                cur_word >>= l;
-                if (cur_pos >= bv.size()) break;
-                cur_block_positions.push_back(cur_pos);
-                if (cur_block_positions.size() == block_size) {
-                    flush_cur_block(cur_block_positions, block_inventory,
-                                    subblock_inventory, overflow_positions);
-                }
+        std::vector<uint64_t> chunk_begin(num_threads + 1);
+        for (uint64_t t = 0; t <= num_threads; ++t) {
+            chunk_begin[t] = data.size() * t / num_threads;
+        }
 
-                // can't do >>= l + 1, can be 64
-                cur_word >>= 1;
-                cur_pos += 1;
-                m_positions += 1;
-            }
+        std::vector<uint64_t> chunk_ones(num_threads);
+        run(num_threads, [&](uint64_t t) {
+            chunk_ones[t] =
+                count_ones(bv, chunk_begin[t], chunk_begin[t + 1]);
+        });
+
+        // thread t builds blocks [first_block[t], first_block[t + 1])
+        std::vector<uint64_t> first_block(num_threads + 1);
+        std::vector<uint64_t> to_skip(num_threads);
+        for (uint64_t t = 0; t != num_threads; ++t) {
+            first_block[t] = (m_positions + block_size - 1) / block_size;
+            to_skip[t] = first_block[t] * block_size - m_positions;
+            m_positions += chunk_ones[t];
         }
-        if (cur_block_positions.size()) {
-            flush_cur_block(cur_block_positions, block_inventory,
-                            subblock_inventory, overflow_positions);
+        first_block[num_threads] = (m_positions + block_size - 1) / block_size;
+
+        std::vector<inventories> invs(num_threads);
+        run(num_threads, [&](uint64_t t) {
+            build_blocks(bv, chunk_begin[t], to_skip[t],
+                         first_block[t + 1] - first_block[t], invs[t]);
+        });
+
+        uint64_t overflow_positions = 0;
+        for (auto const& inv : invs) {
+            for (auto block_pos : inv.block_inventory) {
+                m_block_inventory.push_back(
+                    block_pos < 0 ? block_pos - int64_t(overflow_positions)
+                                  : block_pos);
+            }
+            m_subblock_inventory.insert(m_subblock_inventory.end(),
+                                        inv.subblock_inventory.begin(),
+                                        inv.subblock_inventory.end());
+            m_overflow_positions.insert(m_overflow_positions.end(),
+                                        inv.overflow_positions.begin(),
+                                        inv.overflow_positions.end());
+            overflow_positions += inv.overflow_positions.size();
         }
-        m_block_inventory.swap(block_inventory);
-        m_subblock_inventory.swap(subblock_inventory);
-        m_overflow_positions.swap(overflow_positions);
     }
 
     void swap(darray& other) {
@@ -106,12 +129,92 @@ struct darray {
 
     void load(std::istream& is) {
         essentials::load_pod(is, m_positions);
-        essentials::load_vec(is, m_block_inventory);
-        essentials::load_vec(is, m_subblock_inventory);
-        essentials::load_vec(is, m_overflow_positions);
+        memory::load_vec(is, m_block_inventory);
+        memory::load_vec(is, m_subblock_inventory);
+        memory::load_vec(is, m_overflow_positions);
     }
 
 protected:
+    struct inventories {
+        std::vector<int64_t> block_inventory;
+        std::vector<uint16_t> subblock_inventory;
+        std::vector<uint64_t> overflow_positions;
+    };
+
+    static uint64_t default_num_threads() {
+        return std::max<uint64_t>(1, std::thread::hardware_concurrency());
+    }
+
+    template <typename Function>
+    static void run(uint64_t num_threads, Function f) {
+        std::vector<std::thread> threads;
+        threads.reserve(num_threads - 1);
+        for (uint64_t t = 1; t < num_threads; ++t) {
+            threads.emplace_back(f, t);
+        }
+        f(0);
+        for (auto& t : threads) t.join();
+    }
+
+    static uint64_t count_ones(bit_vector const& bv, size_t begin,
+                               size_t end) {
+        std::vector<uint64_t> const& data = bv.data();
+        uint64_t ones = 0;
+        for (size_t word_idx = begin; word_idx < end; ++word_idx) {
+            uint64_t word = WordGetter()(data, word_idx);
+            size_t cur_pos = word_idx << 6;
+            if (cur_pos + 64 > bv.size()) {  // mask bits past the end
+                size_t valid = bv.size() > cur_pos ? bv.size() - cur_pos : 0;
+                word &= valid ? uint64_t(-1) >> (64 - valid) : 0;
+            }
+            ones += util::popcount(word);
+        }
+        return ones;
+    }
+
+    // NOTE:
+    // build the inventories of num_blocks consecutive blocks,
+    // scanning from word_idx and skipping its first to_skip ones
+    static void build_blocks(bit_vector const& bv, size_t word_idx,
+                             uint64_t to_skip, uint64_t num_blocks,
+                             inventories& inv) {
+        if (!num_blocks) return;
+        std::vector<uint64_t> const& data = bv.data();
+        std::vector<uint64_t> cur_block_positions;
+        cur_block_positions.reserve(block_size);
+
+        for (; word_idx < data.size(); ++word_idx) {
+            size_t cur_pos = word_idx << 6;
+            uint64_t cur_word = WordGetter()(data, word_idx);
+            unsigned long l;
+            while (util::lsb(cur_word, l)) {
+                cur_pos += l;
+                cur_word >>= l;
+                if (cur_pos >= bv.size()) break;
+                if (to_skip) {
+                    --to_skip;
+                } else {
+                    cur_block_positions.push_back(cur_pos);
+                    if (cur_block_positions.size() == block_size) {
+                        flush_cur_block(cur_block_positions,
+                                        inv.block_inventory,
+                                        inv.subblock_inventory,
+                                        inv.overflow_positions);
+                        if (!--num_blocks) return;
+                    }
+                }
+
+                // can't do >>= l + 1, can be 64
+                cur_word >>= 1;
+                cur_pos += 1;
+            }
+        }
+        if (cur_block_positions.size()) {
+            flush_cur_block(cur_block_positions, inv.block_inventory,
+                            inv.subblock_inventory, inv.overflow_positions);
+        }
+    }
+
     static void flush_cur_block(std::vector<uint64_t>& cur_block_positions,
                                 std::vector<int64_t>& block_inventory,
                                 std::vector<uint16_t>& subblock_inventory,
@@ -140,6 +243,7 @@ protected:
     static const size_t block_size = 1024;
     static const size_t subblock_size = 32;
     static const size_t max_in_block_distance = 1 << 16;
+    static const size_t min_words_per_thread = 1 << 16;
 
     size_t m_positions;
     std::vector<int64_t> m_block_inventory;
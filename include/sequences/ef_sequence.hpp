@@ -42,9 +42,13 @@ struct ef_sequence {
 
         bit_vector(&bvb_high_bits).swap(m_high_bits);
         bit_vector(&bvb_low_bits).swap(m_low_bits);
-        darray1(m_high_bits).swap(m_high_bits_d1);
         if (index_on_zeros) {
-            darray0(m_high_bits).swap(m_high_bits_d0);
+            // NOTE: the two indexes are independent, build them together
+            std::thread d0([&] { darray0(m_high_bits).swap(m_high_bits_d0); });
+            darray1(m_high_bits).swap(m_high_bits_d1);
+            d0.join();
+        } else {
+            darray1(m_high_bits).swap(m_high_bits_d1);
         }
     }
 
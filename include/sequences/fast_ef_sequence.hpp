@@ -1,6 +1,7 @@
 #pragma once
 
 #include "utils/util.hpp"
+#include "utils/memory.hpp"
 #include "sequences/darray.hpp"
 #include "vectors/bit_vector.hpp"
 #include "../external/emphf/common.hpp"
@@ -13,13 +14,34 @@
 
 #include <numeric>
 
+#if TONGRAMS_USE_AVX2
+#include <immintrin.h>
+#endif
+
 namespace tongrams {
 
 struct fast_ef_sequence {
-    typedef uint64_t sample_t;
     static const uint64_t sampling_threshold = 128;
-    static const uint64_t log2_sampling_threshold = 7;
     static const uint64_t linear_scan_threshold = 64;
+    static const uint64_t scan_block_size = 8;
+
+    // NOTE:
+    // runs of at least sampling_threshold values are indexed by a static
+    // B-tree over the last value of each block of 2^log2_block_size values.
+    // Keys are 32-bit and relative to the upper bound of the previous run,
+    // so that a node fills a cache line with 16 keys.
+    // The root stores this upper bound followed by at most root_keys keys
+    // and is packed with the roots of other runs, without crossing a cache
+    // line; the other levels follow, top-down, in whole nodes.
+    static const uint64_t log2_block_size = 7;
+    static const uint64_t block_size = uint64_t(1) << log2_block_size;
+    static const uint64_t keys_per_node = 16;
+    static const uint64_t root_keys = keys_per_node - 2;
+    static const uint64_t max_tree_height = 8;
+
+    struct alignas(64) node {
+        uint32_t keys[keys_per_node];
+    };
 
     fast_ef_sequence() : m_size(0), m_l(0) {}
 
@@ -113,32 +135,19 @@ struct fast_ef_sequence {
         size_t run = hi - lo;
 
         if (run >= sampling_threshold) {
-            size_t base = m_offsets.lookup(lo, uint64_adaptor());
-            uint64_t prev_upper = m_samplings[base];
-            id += prev_upper;
-            uint64_t lower_bound = prev_upper;
-            uint64_t tree_height =
-                util::ceil_log2(run) - log2_sampling_threshold;
-
-            for (size_t i = 1, h = 0; h != tree_height; ++h) {
-                sample_t sample = m_samplings[base + i];
-                size_t mid = (lo + hi) >> 1;
-                assert(sample == operator[](mid));
-                if (id == sample) {
-                    *pos = mid;
-                    return;
-                }
-                if (id < sample) {
-                    hi = mid;
-                    i = (i << 1);
-                } else {
-                    lo = mid + 1;
-                    lower_bound = sample;
-                    i = (i << 1) + 1;
-                }
+            uint32_t const* root =
+                keys() + m_offsets.lookup(lo, uint64_adaptor());
+            uint64_t prev_upper = root[0] | (uint64_t(root[1]) << 32);
+            uint64_t lower_bound = 0;
+            uint64_t block = search_tree(root, run, id, lower_bound);
+            if (block == global::not_found) {
+                *pos = global::not_found;
+                return;
             }
-
-            bsearch_scan(lo, hi, id, pos, lower_bound);
+            lo += block << log2_block_size;
+            hi = std::min<uint64_t>(hi, lo + block_size);
+            bsearch_scan(lo, hi, id + prev_upper, pos,
+                         lower_bound + prev_upper);
             return;
         }
 
@@ -220,13 +229,13 @@ struct fast_ef_sequence {
     }
 
     uint64_t samplings_bytes() const {
-        return m_samplings.size() * sizeof(sample_t) + m_offsets.data_bytes();
+        return m_nodes.size() * sizeof(node) + m_offsets.data_bytes();
     }
 
     void swap(fast_ef_sequence& other) {
         std::swap(other.m_size, m_size);
         other.m_offsets.swap(m_offsets);
-        other.m_samplings.swap(m_samplings);
+        other.m_nodes.swap(m_nodes);
         other.m_high_bits.swap(m_high_bits);
         other.m_high_bits_d1.swap(m_high_bits_d1);
         other.m_low_bits.swap(m_low_bits);
@@ -236,7 +245,7 @@ struct fast_ef_sequence {
     void save(std::ostream& os) const {
         essentials::save_pod(os, m_size);
         m_offsets.save(os);
-        essentials::save_vec(os, m_samplings);
+        essentials::save_vec(os, m_nodes);
         m_high_bits.save(os);
         m_high_bits_d1.save(os);
         m_low_bits.save(os);
@@ -246,7 +255,7 @@ struct fast_ef_sequence {
     void load(std::istream& is) {
         essentials::load_pod(is, m_size);
         m_offsets.load(is);
-        essentials::load_vec(is, m_samplings);
+        memory::load_vec(is, m_nodes);
         m_high_bits.load(is);
         m_high_bits_d1.load(is);
         m_low_bits.load(is);
@@ -256,7 +265,7 @@ struct fast_ef_sequence {
 private:
     uint64_t m_size;
     uint_mpht<uint64_t, uint64_t> m_offsets;
-    std::vector<sample_t> m_samplings;
+    std::vector<node> m_nodes;
     bit_vector m_high_bits;
     darray1 m_high_bits_d1;
     bit_vector m_low_bits;
@@ -277,78 +286,127 @@ private:
     }
 
     // optimized scan
+    // NOTE: lower_bound must be the value at position lo - 1 (0 if lo is 0)
     void scan(uint64_t lo, uint64_t hi, uint64_t id, uint64_t* pos,
               uint64_t lower_bound) const {
-        // STEP (1): check high part only
-        uint64_t begin = lo                       // # of 1's
-                         + (lower_bound >> m_l);  // # of 0's
-
-        bit_vector::unary_iterator it(m_high_bits, begin);
+        // STEP (1): skip the values whose high part is less than that of id
+        // by counting zeros in the high bits, a word at a time
+        uint64_t const* data = m_high_bits.data().data();
+        uint64_t lower_high = lower_bound >> m_l;
         uint64_t high_id = id >> m_l;
-        uint64_t v = it.next();
-
-        while (v - lo < high_id) {
-            ++lo;
-            if (lo == hi) {
-                *pos = global::not_found;
-                return;
+        uint64_t begin = lo                // # of 1's
+                         + lower_high;     // # of 0's
+        assert(high_id >= lower_high);
+        uint64_t zeros = high_id - lower_high;  // to be skipped
+        uint64_t ones = 0;                      // skipped so far
+        uint64_t block = begin >> 6;
+        uint64_t mask = uint64_t(-1) << (begin & 63);
+
+        while (zeros) {
+            uint64_t word = ~data[block] & mask;
+            uint64_t z = util::popcount(word);
+            if (z >= zeros) {
+                uint64_t next = (block << 6) +
+                                util::select_in_word(word, zeros - 1) + 1;
+                lo += next - begin - (high_id - lower_high);
+                begin = next;
+                break;
             }
-            v = it.next();
+            zeros -= z;
+            ones += util::popcount(data[block] & mask);
+            if (lo + ones >= hi) {
+                lo = hi;
+                break;
+            }
+            ++block;
+            mask = uint64_t(-1);
         }
 
-        assert(v - lo >= high_id);
-
-        if (v - lo > high_id) {
+        if (lo >= hi) {
             *pos = global::not_found;
             return;
         }
 
-        assert(v - lo == high_id);
-
-        // STEP (2): check low part only
-        uint64_t chunks_in_word;
-        uint64_t chunks_avail;
-        if (m_l) {
-            chunks_in_word = 64 / m_l;
-            chunks_avail = 0;
-        } else {
-            chunks_in_word = 0;
-            chunks_avail = num_ones();
+        // STEP (2): the values sharing the high part of id are the run of
+        // 1's starting at begin: compare their low parts only
+        block = begin >> 6;
+        uint64_t shift = begin & 63;
+        uint64_t run = 0;
+        for (uint64_t max_run = hi - lo; run < max_run;) {
+            uint64_t word = ~(data[block] >> shift);
+            uint64_t n = word ? util::lsb(word) : 64 - shift;
+            run += std::min(n, 64 - shift);
+            if (n < 64 - shift) break;
+            ++block;
+            shift = 0;
         }
-        uint64_t low_mask = (uint64_t(1) << m_l) - 1;
-        uint64_t low_id = id & low_mask;
-        uint64_t word = 0;  // just to silence warning
-
-        it.skip0(1);
-        uint64_t run =
-            std::min(it.position() - v  // # of integers sharing the same high
-                                        // part identified during STEP (1)
-                     ,
-                     hi - lo);
-
-        for (size_t i = 0; i < run; ++i, ++lo) {
-            if (!chunks_avail--) {
-                word = m_low_bits.get_word64(lo * m_l);
-                chunks_avail = chunks_in_word - 1;
-            }
-            uint64_t cur_low = word & low_mask;
-
-            if (cur_low == low_id) {
-                *pos = lo;
-                assert(operator[](lo) == id);
-                return;
-            }
-
-            if (cur_low > low_id) {
-                break;
-            }
+        run = std::min(run, hi - lo);
 
-            word >>= m_l;
+        uint64_t low_id = id & ((uint64_t(1) << m_l) - 1);
+        uint64_t i = find_low(lo, run, low_id);
+        if (i != run and low(lo + i) == low_id) {
+            *pos = lo + i;
+            assert(operator[](lo + i) == id);
+            return;
         }
 
         *pos = global::not_found;
     }
 
+    inline uint64_t low(uint64_t i) const {
+        return m_low_bits.get_bits(i * m_l, m_l);
+    }
+
+    // return the index of the first of the n low parts starting at lo
+    // that is not less than low_id, or n if there is none
+    inline uint64_t find_low(uint64_t lo, uint64_t n, uint64_t low_id) const {
+        uint64_t i = 0;
+#if TONGRAMS_USE_AVX2
+        // NOTE: long runs are compared scan_block_size at a time,
+        // gathering them with unaligned 64-bit loads (so at most
+        // 56 bits each and the whole block must be readable)
+        auto const& words = m_low_bits.data();
+        if (n >= scan_block_size and m_l <= 56) {
+            auto const* base = reinterpret_cast<long long const*>(words.data());
+            uint64_t readable = words.size() * 8 - 8;  // in bytes
+            __m256i offsets =
+                _mm256_add_epi64(_mm256_set1_epi64x(lo * m_l),
+                                 _mm256_set_epi64x(3 * m_l, 2 * m_l, m_l, 0));
+            __m256i step = _mm256_set1_epi64x(4 * m_l);
+            __m256i seven = _mm256_set1_epi64x(7);
+            __m256i low_mask = _mm256_set1_epi64x((uint64_t(1) << m_l) - 1);
+            // NOTE: low parts are < 2^56, so signed comparisons are safe
+            __m256i target = _mm256_set1_epi64x(int64_t(low_id) - 1);
+            for (; i < n; i += scan_block_size) {
+                if ((((lo + i + scan_block_size) * m_l) >> 3) > readable) {
+                    break;
+                }
+                uint32_t geq = 0;
+                for (uint64_t j = 0; j != scan_block_size; j += 4) {
+                    __m256i lows = _mm256_and_si256(
+                        _mm256_srlv_epi64(
+                            _mm256_i64gather_epi64(
+                                base, _mm256_srli_epi64(offsets, 3), 1),
+                            _mm256_and_si256(offsets, seven)),
+                        low_mask);
+                    geq |= uint32_t(_mm256_movemask_pd(_mm256_castsi256_pd(
+                               _mm256_cmpgt_epi64(lows, target))))
+                           << j;
+                    offsets = _mm256_add_epi64(offsets, step);
+                }
+                if (geq) {
+                    return std::min<uint64_t>(i + __builtin_ctz(geq), n);
+                }
+            }
+            i = std::min(i, n);
+        }
+#endif
+        for (; i != n; ++i) {
+            if (low(lo + i) >= low_id) break;
+        }
+        return i;
+    }
+
     void bsearch_scan(uint64_t lo, uint64_t hi, uint64_t id, uint64_t* pos,
                       uint64_t lower_bound) const {
         while (hi - lo > linear_scan_threshold) {
@@ -369,87 +427,179 @@ private:
         return scan(lo, hi, id, pos, lower_bound);
     }
 
-    template <typename T>
-    struct deque_t {
-        deque_t() : m_low(0) {}
+    inline uint32_t const* keys() const {
+        return reinterpret_cast<uint32_t const*>(m_nodes.data());
+    }
 
-        void reserve(size_t n) {
-            m_data.reserve(n);
-        }
+    static inline uint64_t align_to_node(uint64_t offset) {
+        return (offset + keys_per_node - 1) & ~(keys_per_node - 1);
+    }
 
-        T& pop_front() {
-            return m_data[m_low++];
+    // number of keys less than key among the first n <= keys_per_node
+    // NOTE: keys_per_node keys must be readable
+    static inline uint64_t count_less(uint32_t const* keys, uint32_t key,
+                                      uint64_t n) {
+        if (!key) return 0;
+#if TONGRAMS_USE_AVX2
+        __m256i k = _mm256_set1_epi32(key - 1);
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(keys));
+        __m256i b =
+            _mm256_loadu_si256(reinterpret_cast<__m256i const*>(keys + 8));
+        // unsigned comparison: keys[i] <= key - 1
+        __m256i lt_a = _mm256_cmpeq_epi32(_mm256_min_epu32(a, k), a);
+        __m256i lt_b = _mm256_cmpeq_epi32(_mm256_min_epu32(b, k), b);
+        uint64_t mask =
+            uint64_t(_mm256_movemask_ps(_mm256_castsi256_ps(lt_a))) |
+            (uint64_t(_mm256_movemask_ps(_mm256_castsi256_ps(lt_b))) << 8);
+        return util::popcount(mask & ((uint64_t(1) << n) - 1));
+#else
+        uint64_t count = 0;
+        for (uint64_t i = 0; i != n; ++i) count += keys[i] < key;
+        return count;
+#endif
+    }
+
+    // number of nodes in each level of the tree of a run, from the leaves;
+    // returns the height of the tree, i.e., the number of levels below root
+    static uint64_t tree_levels(uint64_t run, uint64_t* nodes) {
+        uint64_t keys = ((run - 1) >> log2_block_size) + 1;
+        uint64_t height = 0;
+        while (keys > root_keys) {
+            keys = util::ceil_div(keys, keys_per_node);
+            nodes[height++] = keys;
+            assert(height <= max_tree_height);
         }
+        nodes[height] = keys;  // keys in the root
+        return height;
+    }
 
-        size_t size() const {
-            return m_data.size() - m_low;
+    // return the block of the run where id must be searched, or
+    // global::not_found if id is greater than the last value of the run;
+    // lower_bound is set to the last value of the previous block
+    inline uint64_t search_tree(uint32_t const* root, uint64_t run,
+                                uint64_t id, uint64_t& lower_bound) const {
+        if (id > uint32_t(-1)) return global::not_found;
+        uint32_t key = id;
+        uint64_t nodes[max_tree_height + 1];
+        uint64_t height = tree_levels(run, nodes);
+
+        uint64_t n = nodes[height];
+        uint64_t j = count_less(root + 2, key, n);
+        if (j == n) return global::not_found;
+        if (j) lower_bound = root[2 + j - 1];
+
+        uint32_t const* level = keys() + align_to_node(root - keys() + 2 + n);
+        for (uint64_t h = height; h != 0; --h) {
+            uint32_t const* node_keys = level + j * keys_per_node;
+            uint64_t c = count_less(node_keys, key, keys_per_node);
+            assert(c < keys_per_node);
+            if (c) lower_bound = node_keys[c - 1];
+            j = j * keys_per_node + c;
+            level += nodes[h - 1] * keys_per_node;
         }
+        return j;
+    }
 
-        void push_back(T const& obj) {
-            m_data.push_back(obj);
+    // append the tree of the run [lo, hi) to keys and return
+    // the offset of its root; keys of missing children are uint32_t(-1)
+    template <typename RandomAccessIterator>
+    static uint64_t fill_tree(uint64_t lo, uint64_t hi,
+                              RandomAccessIterator it,
+                              std::vector<uint32_t>& keys) {
+        uint64_t prev_upper = lo ? it[lo - 1] : 0;
+        std::vector<uint32_t> level_keys;
+        for (uint64_t end = lo + block_size;; end += block_size) {
+            uint64_t key = it[std::min(end, hi) - 1] - prev_upper;
+            if (key > uint32_t(-1)) {
+                throw std::runtime_error("run values exceed 32 bits");
+            }
+            level_keys.push_back(key);
+            if (end >= hi) break;
         }
 
-    private:
-        size_t m_low;
-        std::vector<T> m_data;
-    };
+        std::vector<std::vector<uint32_t>> levels;
+        while (level_keys.size() > root_keys) {
+            uint64_t nodes = util::ceil_div(level_keys.size(), keys_per_node);
+            std::vector<uint32_t> level(nodes * keys_per_node, uint32_t(-1));
+            std::vector<uint32_t> parent_keys;
+            for (uint64_t i = 0; i != nodes; ++i) {
+                uint64_t begin = i * keys_per_node;
+                uint64_t end = std::min<uint64_t>(level_keys.size(),
+                                                  begin + keys_per_node);
+                std::copy(level_keys.begin() + begin, level_keys.begin() + end,
+                          level.begin() + begin);
+                parent_keys.push_back(level_keys[end - 1]);
+            }
+            levels.push_back(std::move(level));
+            level_keys.swap(parent_keys);
+        }
 
-    template <typename RandomAccessIterator>
-    static void fill_samplings(uint64_t lo, uint64_t hi, uint64_t tree_height,
-                               RandomAccessIterator it,
-                               std::vector<sample_t>& samplings) {
-        typedef std::pair<uint64_t, uint64_t> range_t;
-        range_t root(lo, hi);
-        deque_t<range_t> ranges;  // BFS-order
-        ranges.reserve((size_t(1) << tree_height) - 1);
-        ranges.push_back(root);
-        for (uint64_t h = 0; h != tree_height; ++h) {
-            uint64_t nodes = uint64_t(1) << h;
-            for (uint64_t i = 0; i < nodes; ++i) {
-                auto r = ranges.pop_front();
-                uint64_t l = r.first;
-                uint64_t h = r.second;
-                size_t mid = (l + h) >> 1;
-                samplings.push_back(it[mid]);
-                range_t left(l, mid);
-                range_t right(mid + 1, h);
-                ranges.push_back(left);
-                ranges.push_back(right);
+        uint64_t root_size = 2 + level_keys.size();
+        if (keys.size() % keys_per_node + root_size > keys_per_node) {
+            keys.resize(align_to_node(keys.size()), uint32_t(-1));
+        }
+        uint64_t root = keys.size();
+        keys.push_back(uint32_t(prev_upper));
+        keys.push_back(uint32_t(prev_upper >> 32));
+        keys.insert(keys.end(), level_keys.begin(), level_keys.end());
+        if (!levels.empty()) {
+            keys.resize(align_to_node(keys.size()), uint32_t(-1));
+            for (auto level = levels.rbegin(); level != levels.rend();
+                 ++level) {
+                keys.insert(keys.end(), level->begin(), level->end());
             }
         }
+        return root;
     }
 
     template <typename RandomAccessIterator>
     void build(RandomAccessIterator begin, uint64_t n, uint64_t u,
                std::vector<uint64_t> const& pointers) {
-        {
-            std::vector<uint64_t> from;
-            std::vector<uint64_t> to;
-            std::vector<sample_t> samplings;
-
-            uint64_t ptr_begin = pointers.front();
-            for (uint64_t i = 1; i < pointers.size(); ++i) {
-                uint64_t ptr_end = pointers[i];
-                uint64_t range = ptr_end - ptr_begin;
-                if (range >= sampling_threshold) {
-                    from.push_back(ptr_begin);
-                    to.push_back(samplings.size());
-                    uint64_t tree_height =
-                        util::ceil_log2(range) - log2_sampling_threshold;
-                    // push previous range upperbound
-                    samplings.push_back(ptr_begin ? begin[ptr_begin - 1] : 0);
-                    fill_samplings(ptr_begin, ptr_end, tree_height, begin,
-                                   samplings);
-                }
-                ptr_begin = ptr_end;
-            }
-            m_samplings.swap(samplings);
+        // NOTE: samplings only read the values,
+        // so they are built while encoding the sequence
+        std::thread samplings_thread([&] { build_samplings(begin, pointers); });
+        try {
+            encode(begin, n, u);
+        } catch (...) {
+            samplings_thread.join();
+            throw;
+        }
+        samplings_thread.join();
+    }
 
-            if (from.size()) {
-                m_offsets.build(from, to, uint64_adaptor());
+    template <typename RandomAccessIterator>
+    void build_samplings(RandomAccessIterator begin,
+                         std::vector<uint64_t> const& pointers) {
+        std::vector<uint64_t> from;
+        std::vector<uint64_t> to;
+        std::vector<uint32_t> keys;
+
+        uint64_t ptr_begin = pointers.front();
+        for (uint64_t i = 1; i < pointers.size(); ++i) {
+            uint64_t ptr_end = pointers[i];
+            uint64_t range = ptr_end - ptr_begin;
+            if (range >= sampling_threshold) {
+                from.push_back(ptr_begin);
+                to.push_back(fill_tree(ptr_begin, ptr_end, begin, keys));
             }
+            ptr_begin = ptr_end;
         }
 
+        // NOTE: pad with a whole node, so that
+        // keys_per_node keys are always readable
+        keys.resize(align_to_node(keys.size()) + keys_per_node, uint32_t(-1));
+        std::vector<node> nodes(keys.size() / keys_per_node);
+        std::copy(keys.begin(), keys.end(),
+                  reinterpret_cast<uint32_t*>(nodes.data()));
+        m_nodes.swap(nodes);
+
+        if (from.size()) {
+            m_offsets.build(from, to, uint64_adaptor());
+        }
+    }
+
+    template <typename RandomAccessIterator>
+    void encode(RandomAccessIterator begin, uint64_t n, uint64_t u) {
         m_size = n;
         m_l = uint8_t((n && u / n) ? util::msb(u / n) : 0);
         bit_vector_builder bvb_high_bits(n + (u >> m_l) + 1);
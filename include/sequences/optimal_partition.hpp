@@ -0,0 +1,122 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+#include "utils/util.hpp"
+
+namespace pef {
+
+// NOTE:
+// approximation algorithm of "Partitioned Elias-Fano Indexes"
+// by G. Ottaviano and R. Venturini (SIGIR 2014).
+// The cost of a partition is given by cost_fun(universe, n) and
+// the returned partition costs at most (1 + eps1)(1 + eps2) times
+// the optimal one. One sliding window is kept for each cost bound
+// cost_lb * (1 + eps2)^i, up to cost_lb / eps1, so the running time
+// is O(n log_{1+eps2}(1/eps1)).
+struct optimal_partition {
+    // end positions (exclusive) of the partitions
+    std::vector<uint64_t> partition;
+    uint64_t cost_opt;
+
+    template <typename Iterator>
+    struct cost_window {
+        cost_window(Iterator begin, uint64_t cost_upper_bound)
+            : start_it(begin)
+            , end_it(begin)
+            , start(0)
+            , end(0)
+            , min_p(*begin)
+            , max_p(0)
+            , cost_upper_bound(cost_upper_bound) {}
+
+        uint64_t universe() const {
+            return max_p - min_p + 1;
+        }
+
+        uint64_t size() const {
+            return end - start;
+        }
+
+        // NOTE: the last value of the previous partition
+        // is the base of the next one
+        void advance_start() {
+            min_p = *start_it;
+            ++start;
+            ++start_it;
+        }
+
+        void advance_end() {
+            max_p = *end_it;
+            ++end;
+            ++end_it;
+        }
+
+        Iterator start_it;
+        Iterator end_it;
+        uint64_t start;
+        uint64_t end;
+        uint64_t min_p;
+        uint64_t max_p;
+        uint64_t cost_upper_bound;
+    };
+
+    optimal_partition() : cost_opt(0) {}
+
+    template <typename Iterator, typename CostFunction>
+    optimal_partition(Iterator begin, uint64_t n, CostFunction cost_fun,
+                      double eps1, double eps2) {
+        assert(n > 0);
+        uint64_t universe = *(begin + (n - 1)) - *begin + 1;
+        uint64_t single_block_cost = cost_fun(universe, n);
+        std::vector<uint64_t> min_cost(n + 1, single_block_cost);
+        min_cost[0] = 0;
+
+        // create the required windows: one for each power of (1 + eps2)
+        std::vector<cost_window<Iterator>> windows;
+        uint64_t cost_lb = cost_fun(1, 1);  // minimum cost
+        uint64_t cost_bound = cost_lb;
+        while (eps1 == 0 or cost_bound < cost_lb / eps1) {
+            windows.emplace_back(begin, cost_bound);
+            if (cost_bound >= single_block_cost) break;
+            cost_bound = std::max<uint64_t>(cost_bound + 1,
+                                             cost_bound * (1 + eps2));
+        }
+
+        std::vector<uint64_t> path(n + 1, 0);
+        for (uint64_t i = 0; i < n; ++i) {
+            uint64_t last_end = i + 1;
+            for (auto& window : windows) {
+                assert(window.start == i);
+                while (window.end < last_end) window.advance_end();
+
+                uint64_t window_cost;
+                while (true) {
+                    window_cost = cost_fun(window.universe(), window.size());
+                    if ((min_cost[i] + window_cost < min_cost[window.end])) {
+                        min_cost[window.end] = min_cost[i] + window_cost;
+                        path[window.end] = i;
+                    }
+                    last_end = window.end;
+                    if (window.end == n) break;
+                    if (window_cost >= window.cost_upper_bound) break;
+                    window.advance_end();
+                }
+
+                window.advance_start();
+            }
+        }
+
+        uint64_t curr_pos = n;
+        while (curr_pos != 0) {
+            partition.push_back(curr_pos);
+            curr_pos = path[curr_pos];
+        }
+        std::reverse(partition.begin(), partition.end());
+        cost_opt = min_cost[n];
+    }
+};
+
+}  // namespace pef
@@ -0,0 +1,438 @@
+#pragma once
+
+#include <stdexcept>
+
+#include "sequences/integer_codes.hpp"
+#include "sequences/compact_elias_fano.hpp"
+#include "sequences/optimal_partition.hpp"
+#include "utils/util.hpp"
+#include "vectors/bit_vector.hpp"
+#include "vectors/compact_vector.hpp"
+#include "utils/memory.hpp"
+
+namespace pef {
+
+// NOTE:
+// partitioned Elias-Fano as uniform_pef_sequence, but partition
+// boundaries are chosen by optimal_partition to minimize the space
+// of the encoded partitions, so partitions have variable size.
+// Base, begin and endpoint of each partition are interleaved in a
+// directory, so that switching partition touches a single cache line.
+// The partition containing a position is found by means of a sample
+// taken every 2^log_sampling positions, followed by a (short) linear scan.
+struct optimal_pef_sequence {
+    static const uint8_t log_sampling = 8;
+
+    optimal_pef_sequence() : m_size(0), m_universe(0), m_partitions(0) {}
+
+    template <typename Iterator, typename Pointers = std::vector<uint64_t>>
+    void build(Iterator begin, uint64_t n, Pointers& pointers,
+               uint8_t /*order*/) {
+        std::vector<uint64_t> values;
+        values.reserve(n);
+        uint64_t prev_upper = 0;
+        auto pointers_it = pointers.begin();
+        uint64_t start = *pointers_it;
+        ++pointers_it;
+        uint64_t end = *pointers_it;
+        uint64_t run = end - start;
+        uint64_t within = 0;
+        for (uint64_t i = 0; i < n; ++i, ++begin) {
+            if (within == run) {
+                within = 0;
+                do {
+                    start = end;
+                    ++pointers_it;
+                    end = *pointers_it;
+                    run = end - start;
+                } while (!run);
+                prev_upper = values.size() ? values.back() : 0;
+            }
+            uint64_t v = *begin;
+            values.push_back(v + prev_upper);
+            ++within;
+        }
+        assert(values.size() == n);
+        write(values, values.back());
+    }
+
+    template <typename Iterator>
+    void build(Iterator begin, uint64_t n, uint64_t universe,
+               uint8_t /*order*/) {
+        // the partitioning needs multiple passes over the values
+        std::vector<uint64_t> values;
+        values.reserve(n);
+        for (uint64_t i = 0; i < n; ++i, ++begin) {
+            values.push_back(*begin);
+        }
+        write(values, universe);
+    }
+
+    void write(std::vector<uint64_t> const& values, uint64_t universe) {
+        uint64_t n = values.size();
+        assert(n > 0);
+        m_size = n;
+        m_universe = universe;
+
+        pef_global_parameters params;
+
+        // NOTE: fixed cost of a partition, i.e., its directory entry
+        uint64_t fixed_cost = 3 * tongrams::util::ceil_log2(universe + 1);
+        auto cost_fun = [&](uint64_t u, uint64_t k) {
+            return compact_elias_fano::bitsize(params, u, k) + fixed_cost;
+        };
+        static const double eps1 = 0.03;
+        static const double eps2 = 0.3;
+        optimal_partition opt(values.begin(), n, cost_fun, eps1, eps2);
+        m_partitions = opt.partition.size();
+
+        tongrams::bit_vector_builder data_bvb;
+        std::vector<uint64_t> directory;
+        std::vector<uint64_t> cur_partition;
+        directory.reserve(3 * (m_partitions + 1));
+
+        uint64_t cur_i = 0;
+        uint64_t cur_base = values.front();
+        for (auto partition_end : opt.partition) {
+            assert(partition_end > cur_i);
+            directory.push_back(cur_base);
+            directory.push_back(cur_i);
+            directory.push_back(data_bvb.size());
+            cur_partition.clear();
+            for (; cur_i < partition_end; ++cur_i) {
+                cur_partition.push_back(values[cur_i] - cur_base);
+            }
+            compact_elias_fano::write(data_bvb, cur_partition.begin(),
+                                      cur_partition.back() + 1,
+                                      cur_partition.size(), params);
+            cur_base = values[partition_end - 1];
+        }
+        assert(cur_i == n);
+        directory.push_back(cur_base);
+        directory.push_back(n);
+        directory.push_back(data_bvb.size());
+
+        uint64_t max_entry =
+            std::max(cur_base, std::max(n, uint64_t(data_bvb.size())));
+        tongrams::compact_vector::builder directory_cvb(
+            directory.begin(), directory.size(),
+            tongrams::util::ceil_log2(max_entry + 1));
+
+        uint64_t num_samples = ((n - 1) >> log_sampling) + 1;
+        tongrams::compact_vector::builder samples_cvb(
+            num_samples, tongrams::util::ceil_log2(m_partitions + 1));
+        for (uint64_t i = 0, p = 0; i < num_samples; ++i) {
+            uint64_t position = i << log_sampling;
+            while (directory[3 * (p + 1) + 1] <= position) ++p;
+            samples_cvb.push_back(p);
+        }
+
+        m_directory.build(directory_cvb);
+        m_samples.build(samples_cvb);
+        m_data.build(&data_bvb);
+
+        // init enumerator to map ids needed by pef_rtrie
+        init_enumerator();
+    }
+
+    // NOTE: the reads move a copy of the initialized enumerator,
+    // so that many threads can query the same sequence
+    inline uint64_t operator[](uint64_t position) const {
+        enumerator e = m_enum;
+        return e.move(position).second;
+    }
+
+    void find(tongrams::pointer_range const& r, uint64_t id,
+              uint64_t* pos) const {
+        *pos = tongrams::global::not_found;
+        if (r.begin == r.end) return;
+
+        assert(r.end > r.begin);
+        assert(r.end <= size());
+
+        enumerator e = m_enum;
+        uint64_t prev_upper = e.prev_value(r.begin);
+
+        // NOTE: the first value of a range may be
+        // equal to the last value of the previous range
+        if (!id) {
+            if (e.move(r.begin).second == prev_upper) *pos = r.begin;
+            return;
+        }
+
+        id += prev_upper;
+        auto pos_value = e.next_geq(id, r.end);
+        if (pos_value.second == id and pos_value.first < r.end) {
+            *pos = pos_value.first;
+        }
+    }
+
+    struct enumerator {
+        typedef std::pair<uint64_t, uint64_t> value_type;  // (position, value)
+
+        enumerator() {}
+
+        void init(tongrams::bit_vector const& bv,
+                  tongrams::compact_vector const& directory,
+                  tongrams::compact_vector const& samples, uint64_t n,
+                  uint64_t universe, uint64_t partitions) {
+            m_partitions = partitions;
+            m_size = n;
+            m_universe = universe;
+            m_bv = &bv;
+            m_directory = &directory;
+            m_samples = &samples;
+            m_position = 0;
+            m_first = true;  // for next()
+            switch_partition(0);
+        }
+
+        static const uint64_t linear_scan_threshold = 8;
+
+        value_type ALWAYSINLINE move(uint64_t position) {
+            assert(position <= size());
+            m_position = position;
+            if (m_position >= m_cur_begin && m_position < m_cur_end) {
+                uint64_t val =
+                    m_cur_base +
+                    m_partition_enum.move(m_position - m_cur_begin).second;
+                return value_type(m_position, val);
+            }
+            return slow_move();
+        }
+
+        // NOTE: returns the value preceding position (0 if position is 0)
+        // and switches to the partition of position, so that the value
+        // is read from the directory if position begins a partition
+        uint64_t ALWAYSINLINE prev_value(uint64_t position) {
+            assert(position < size());
+            if (position < m_cur_begin || position >= m_cur_end) {
+                switch_partition(partition_of(position));
+            }
+            if (position == m_cur_begin) {
+                return position ? m_cur_base : 0;
+            }
+            return move(position - 1).second;
+        }
+
+        // NOTE: must be called after prev_value(range_begin)
+        value_type ALWAYSINLINE next_geq(uint64_t lower_bound,
+                                         uint64_t range_end) {
+            if (LIKELY(lower_bound >= m_cur_base &&
+                       lower_bound <= m_cur_upper_bound)) {
+                auto val = m_partition_enum.next_geq(lower_bound - m_cur_base);
+                m_position = m_cur_begin + val.first;
+                return value_type(m_position, m_cur_base + val.second);
+            }
+
+            if (lower_bound < m_cur_base) {  // out of bounds form the left
+                return value_type(m_position, tongrams::global::not_found);
+            }
+
+            return slow_next_geq(lower_bound, range_end);
+        }
+
+        uint64_t size() const {
+            return m_size;
+        }
+
+        uint64_t partition_of(uint64_t position) const {
+            assert(position < size());
+            uint64_t partition = m_samples->access(position >> log_sampling);
+            while (begin(partition + 1) <= position) ++partition;
+            return partition;
+        }
+
+        value_type NOINLINE slow_move() {
+            if (m_position == size()) {
+                switch_partition(m_partitions - 1);
+                m_partition_enum.move(m_partition_enum.size());
+                return value_type(m_position, m_universe);
+            }
+            switch_partition(partition_of(m_position));
+            uint64_t val =
+                m_cur_base +
+                m_partition_enum.move(m_position - m_cur_begin).second;
+            return value_type(m_position, val);
+        }
+
+        value_type NOINLINE slow_next_geq(uint64_t lower_bound,
+                                          uint64_t range_end) {
+            // search the first partition whose upper bound is >= lower_bound:
+            // the range usually spans few partitions, whose directory entries
+            // are contiguous, so try a linear scan first
+            uint64_t partition = m_cur_partition + 1;
+            for (uint64_t i = 0; i != linear_scan_threshold; ++i) {
+                if (partition == m_partitions or
+                    begin(partition) >= range_end) {  // out of range
+                    return value_type(m_position,
+                                      tongrams::global::not_found);
+                }
+                if (base(partition + 1) >= lower_bound) {
+                    switch_partition(partition);
+                    return next_geq(lower_bound, range_end);
+                }
+                ++partition;
+            }
+
+            uint64_t lo = partition;
+            uint64_t hi = partition_of(range_end - 1) + 1;
+            while (lo < hi) {
+                uint64_t mid = (lo + hi) / 2;
+                if (base(mid + 1) < lower_bound) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            if (lo == m_partitions or begin(lo) >= range_end) {
+                return value_type(m_position, tongrams::global::not_found);
+            }
+
+            switch_partition(lo);
+            return next_geq(lower_bound, range_end);
+        }
+
+        // used for linear scan in stats.cpp
+        uint64_t next() {
+            if (UNLIKELY(m_first)) {
+                switch_partition(0);
+                uint64_t offset = m_partition_enum.move(0).second;
+                m_first = false;
+                return m_cur_base + offset;
+            }
+
+            ++m_position;
+            if (LIKELY(m_position < m_cur_end)) {
+                uint64_t offset = m_partition_enum.next().second;
+                return m_cur_base + offset;
+            }
+            return slow_next();
+        }
+
+        // used for linear scan in stats.cpp
+        uint64_t slow_next() {
+            if (UNLIKELY(m_position == m_size)) {
+                assert(m_cur_partition == m_partitions - 1);
+                return m_universe;
+            }
+            switch_partition(m_cur_partition + 1);
+            uint64_t val = m_cur_base + m_partition_enum.move(0).second;
+            return val;
+        }
+
+        void switch_partition(uint64_t partition) {
+            assert(partition < m_partitions);
+
+            uint64_t partition_begin = endpoint(partition);
+            tongrams::util::prefetch(m_bv->data().data() +
+                                     partition_begin / 64);
+
+            m_cur_partition = partition;
+            m_cur_begin = begin(partition);
+            m_cur_end = begin(partition + 1);
+            m_cur_base = base(partition);
+            m_cur_upper_bound = base(partition + 1);
+
+            m_partition_enum = compact_elias_fano::enumerator(
+                *m_bv, partition_begin, m_cur_upper_bound - m_cur_base + 1,
+                m_cur_end - m_cur_begin, m_params);
+        }
+
+        pef_global_parameters m_params;
+        uint64_t m_partitions;
+        uint64_t m_size;
+        uint64_t m_universe;
+
+        uint64_t m_position;
+        uint64_t m_cur_partition;
+        uint64_t m_cur_begin;
+        uint64_t m_cur_end;
+        uint64_t m_cur_base;
+        uint64_t m_cur_upper_bound;
+
+        tongrams::bit_vector const* m_bv;
+        compact_elias_fano::enumerator m_partition_enum;
+        tongrams::compact_vector const* m_directory;
+        tongrams::compact_vector const* m_samples;
+
+        bool m_first;
+
+    private:
+        // directory entry of a partition: (base, begin, endpoint),
+        // where base is the upper bound of the previous partition
+        inline uint64_t base(uint64_t partition) const {
+            return m_directory->access(3 * partition);
+        }
+
+        inline uint64_t begin(uint64_t partition) const {
+            return m_directory->access(3 * partition + 1);
+        }
+
+        inline uint64_t endpoint(uint64_t partition) const {
+            return m_directory->access(3 * partition + 2);
+        }
+    };
+
+    // used for linear scan in stats.cpp
+    enumerator begin() const {
+        enumerator e;
+        e.init(m_data, m_directory, m_samples, m_size, m_universe,
+               m_partitions);
+        return e;
+    }
+
+    uint64_t size() const {
+        return m_size;
+    }
+
+    uint64_t universe() const {
+        return m_universe;
+    }
+
+    uint64_t num_partitions() const {
+        return m_partitions;
+    }
+
+    uint64_t bytes() const {
+        return sizeof(m_size) + sizeof(m_universe) + sizeof(m_partitions) +
+               m_directory.bytes() + m_samples.bytes() + m_data.bytes();
+    }
+
+    void save(std::ostream& os) const {
+        essentials::save_pod(os, m_size);
+        essentials::save_pod(os, m_universe);
+        essentials::save_pod(os, m_partitions);
+        m_directory.save(os);
+        m_samples.save(os);
+        m_data.save(os);
+    }
+
+    void load(std::istream& is) {
+        essentials::load_pod(is, m_size);
+        essentials::load_pod(is, m_universe);
+        essentials::load_pod(is, m_partitions);
+        m_directory.load(is);
+        m_samples.load(is);
+        m_data.load(is);
+
+        // NOTE: the buffers are empty when skipped
+        if (m_size and !tongrams::memory::skipping) init_enumerator();
+    }
+
+private:
+    uint64_t m_size;
+    uint64_t m_universe;
+    uint64_t m_partitions;
+    tongrams::compact_vector m_directory;
+    tongrams::compact_vector m_samples;
+    tongrams::bit_vector m_data;
+    enumerator m_enum;
+
+    void init_enumerator() {
+        m_enum.init(m_data, m_directory, m_samples, m_size, m_universe,
+                    m_partitions);
+    }
+};
+
+}  // namespace pef
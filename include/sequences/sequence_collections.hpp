@@ -6,6 +6,7 @@
 #include <unordered_set>
 
 #include "utils/util.hpp"
+#include "utils/memory.hpp"
 
 namespace tongrams {
 
@@ -177,7 +178,7 @@ struct quantized_sequence_collection {
                 (std::streamsize)(sizeof(uint8_t) * order));
         m_sequences.resize(order);
         for (auto& s : m_sequences) {
-            essentials::load_vec(is, s);
+            memory::load_vec(is, s);
         }
     }
 
@@ -203,11 +204,12 @@ struct sequence_collection {
             m_sequences.reserve(n);
         }
 
-        void eat_value(uint64_t val) {
-            if (m_distinct_counts.find(val) != m_distinct_counts.end()) {
-                ++m_distinct_counts[val];
+        void eat_value(uint64_t val, uint64_t frequency = 1) {
+            auto it = m_distinct_counts.find(val);
+            if (it != m_distinct_counts.end()) {
+                it->second += frequency;
             } else {
-                m_distinct_counts.emplace(val, 1);
+                m_distinct_counts.emplace(val, frequency);
             }
         }
 
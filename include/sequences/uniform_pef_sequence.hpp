@@ -7,6 +7,7 @@
 #include "utils/util.hpp"
 #include "vectors/bit_vector.hpp"
 #include "vectors/compact_vector.hpp"
+#include "utils/memory.hpp"
 
 namespace pef {
 
@@ -148,15 +149,19 @@ struct uniform_pef_sequence {
         m_data.build(&data_bvb);
 
         // init enumerator to map ids needed by pef_rtrie
-        e.init(m_data, m_upper_bounds, m_size, m_universe, m_partitions,
-               m_log_partition_size);
+        m_enum.init(m_data, m_upper_bounds, m_size, m_universe, m_partitions,
+                    m_log_partition_size);
     }
 
-    inline uint64_t operator[](uint64_t position) {
+    // NOTE: the reads move a copy of the initialized enumerator,
+    // so that many threads can query the same sequence
+    inline uint64_t operator[](uint64_t position) const {
+        enumerator e = m_enum;
         return e.move(position).second;
     }
 
-    void find(tongrams::pointer_range const& r, uint64_t id, uint64_t* pos) {
+    void find(tongrams::pointer_range const& r, uint64_t id,
+              uint64_t* pos) const {
         if (r.begin == r.end) {
             *pos = tongrams::global::not_found;
             return;
@@ -170,6 +175,7 @@ struct uniform_pef_sequence {
             return;
         }
 
+        enumerator e = m_enum;
         if (m_partitions > 1) {
             uint64_t partition_begin = r.begin >> m_log_partition_size;
             e.switch_partition(partition_begin);
@@ -177,7 +183,7 @@ struct uniform_pef_sequence {
 
         uint64_t prev_upper = 0;
         if (LIKELY(r.begin)) {
-            prev_upper = operator[](r.begin - 1);
+            prev_upper = e.move(r.begin - 1).second;
         }
 
         id += prev_upper;
@@ -506,9 +512,10 @@ struct uniform_pef_sequence {
         m_data.load(is);
         essentials::load_pod(is, m_log_partition_size);
 
-        if (m_size) {
-            e.init(m_data, m_upper_bounds, m_size, m_universe, m_partitions,
-                   m_log_partition_size);
+        // NOTE: the buffers are empty when skipped
+        if (m_size and !tongrams::memory::skipping) {
+            m_enum.init(m_data, m_upper_bounds, m_size, m_universe,
+                        m_partitions, m_log_partition_size);
         }
     }
 
@@ -520,7 +527,7 @@ private:
     tongrams::compact_vector m_upper_bounds;
     tongrams::bit_vector m_data;
     uint8_t m_log_partition_size;
-    enumerator e;
+    enumerator m_enum;
 };
 
 }  // namespace pef
@@ -3,21 +3,29 @@
 #include <deque>
 
 #include "utils/util.hpp"
+#include "utils/parallel_gzip_writer.hpp"
 #include "../external/essentials/include/essentials.hpp"
 
 namespace tongrams {
 
 template <typename Comparator, typename LineHandler>
 struct sorter {
+    // NOTE: if compression_threads > 0, the final output
+    // is written as (multi-member) gzip using that many threads,
+    // whereas temporary files are always written as plain text.
+    // If output_filename is empty, the sorted runs are not merged
+    // and can be streamed in order with a runs_merger.
     sorter(uint64_t n, Comparator& comparator,
-           std::string const& output_filename, std::string const& tmp_dir)
+           std::string const& output_filename, std::string const& tmp_dir,
+           uint64_t compression_threads = 0)
         : m_n(n)
         , m_comparator(comparator)
         , m_output_filename(output_filename)
-        , m_tmp_dir(tmp_dir) {}
+        , m_tmp_dir(tmp_dir)
+        , m_compression_threads(compression_threads) {}
 
     ~sorter() {
-        merge_batches();
+        if (!m_output_filename.empty()) merge_batches();
     }
 
     template <typename Iterator>
@@ -25,8 +33,9 @@ struct sorter {
         if (begin == end) return;
         size_t n = end - begin;
         std::cout << "sorting " << n << " records" << std::endl;
-        auto output_filename =
-            n == m_n ? m_output_filename : next_tmp_filename();
+        auto output_filename = n == m_n and !m_output_filename.empty()
+                                   ? m_output_filename
+                                   : next_tmp_filename();
         essentials::logger("sorting " + output_filename);
         std::sort(begin, end, m_comparator);
         essentials::logger("flushing " + output_filename);
@@ -34,12 +43,23 @@ struct sorter {
         m_files.push_back(output_filename);
     }
 
+    std::vector<std::string> release_runs() {
+        std::vector<std::string> runs(m_files.begin(), m_files.end());
+        m_files.clear();
+        return runs;
+    }
+
 private:
     uint64_t m_n;
     Comparator& m_comparator;
     std::string m_output_filename;
     std::deque<std::string> m_files;
     std::string m_tmp_dir;
+    uint64_t m_compression_threads;
+
+    bool compress(std::string const& output_filename) const {
+        return m_compression_threads and output_filename == m_output_filename;
+    }
 
     std::string next_tmp_filename() {
         return m_tmp_dir + "/.XXX." +
@@ -69,24 +89,33 @@ private:
     template <typename Iterator>
     void flush(Iterator begin, Iterator end,
                std::string const& output_filename) {
-        std::ofstream os;
-        os.open(output_filename.c_str(),
-                std::ofstream::ate | std::ofstream::app);
+        if (compress(output_filename)) {
+            parallel_gzip_writer os(output_filename, m_compression_threads);
+            write_batch(begin, end, os);
+            os.close();
+        } else {
+            std::ofstream os;
+            os.open(output_filename.c_str(),
+                    std::ofstream::ate | std::ofstream::app);
+            write_batch(begin, end, os);
+            os.close();
+        }
+    }
 
+    template <typename Iterator, typename Output>
+    void write_batch(Iterator begin, Iterator end, Output& os) {
         if (LineHandler::value_t == value_type::count) {
             uint64_t n = uint64_t(end - begin);
             building_util::write(os, std::to_string(n));
-            os << '\n';
+            os.put('\n');
         }
 
         std::string line_to_write;
         for (auto it = begin; it != end; ++it) {
             LineHandler::format_line(*it, line_to_write);
             building_util::write(os, line_to_write);
-            os << '\n';
+            os.put('\n');
         }
-
-        os.close();
     }
 
     void merge(std::string const& filename1, std::string const& filename2,
@@ -94,10 +123,22 @@ private:
         essentials::logger("merging files " + filename1 + " and " + filename2 +
                            " into " + output_filename);
 
-        std::ofstream os;
-        os.open(output_filename.c_str(),
-                std::ofstream::ate | std::ofstream::app);
+        if (compress(output_filename)) {
+            parallel_gzip_writer os(output_filename, m_compression_threads);
+            merge_into(filename1, filename2, os);
+            os.close();
+        } else {
+            std::ofstream os;
+            os.open(output_filename.c_str(),
+                    std::ofstream::ate | std::ofstream::app);
+            merge_into(filename1, filename2, os);
+            os.close();
+        }
+    }
 
+    template <typename Output>
+    void merge_into(std::string const& filename1, std::string const& filename2,
+                    Output& os) {
         std::ifstream input1(filename1.c_str());
         std::ifstream input2(filename2.c_str());
         std::string line1, line2;
@@ -114,7 +155,7 @@ private:
             }
             if (num_grams) {
                 building_util::write(os, std::to_string(num_grams));
-                os << '\n';
+                os.put('\n');
             } else {
                 throw std::runtime_error("num of grams must be > 0");
             }
@@ -130,22 +171,22 @@ private:
             while (true) {
                 if (m_comparator(t1, t2)) {
                     building_util::write(os, line1);
-                    os << '\n';
+                    os.put('\n');
                     if (std::getline(input1, line1)) {
                         t1 = LineHandler::parse_line(line1);
                     } else {
                         building_util::write(os, line2);
-                        os << '\n';
+                        os.put('\n');
                         break;
                     }
                 } else {
                     building_util::write(os, line2);
-                    os << '\n';
+                    os.put('\n');
                     if (std::getline(input2, line2)) {
                         t2 = LineHandler::parse_line(line2);
                     } else {
                         building_util::write(os, line1);
-                        os << '\n';
+                        os.put('\n');
                         break;
                     }
                 }
@@ -155,16 +196,149 @@ private:
         if (input1.eof()) {
             while (std::getline(input2, line2)) {
                 building_util::write(os, line2);
-                os << '\n';
+                os.put('\n');
             }
         } else {
             while (std::getline(input1, line1)) {
                 building_util::write(os, line1);
-                os << '\n';
+                os.put('\n');
+            }
+        }
+    }
+};
+
+// NOTE:
+// k-way merge of the sorted runs produced by a sorter.
+// It exposes the same interface of grams_gzparser, so that
+// builders can consume the merged records without writing them to disk.
+// Run files are removed upon destruction.
+template <typename Comparator, typename LineHandler>
+struct runs_merger {
+    typedef decltype(LineHandler::parse_line(std::string())) record_type;
+
+    struct iterator {
+        iterator(runs_merger* m, uint64_t line_num)
+            : m_merger(m), m_cur_line_num(line_num) {}
+
+        record_type const& operator*() const {
+            return m_merger->m_records[m_merger->m_heap.front()];
+        }
+
+        iterator& operator++() {
+            m_merger->advance();
+            ++m_cur_line_num;
+            if (m_cur_line_num % 100000000 == 0) {
+                essentials::logger("Processed " +
+                                   std::to_string(m_cur_line_num) + " lines");
+            }
+            return *this;
+        }
+
+        bool operator==(iterator const& other) const {
+            return m_cur_line_num == other.m_cur_line_num;
+        }
+
+        bool operator!=(iterator const& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        runs_merger* m_merger;
+        uint64_t m_cur_line_num;
+    };
+
+    runs_merger(std::vector<std::string> const& filenames,
+                Comparator& comparator)
+        : m_filenames(filenames)
+        , m_comparator(comparator)
+        , m_num_lines(0)
+        , m_inputs(filenames.size())
+        , m_lines(filenames.size())
+        , m_records(filenames.size()) {
+        if (filenames.empty()) {
+            throw std::runtime_error("no runs to merge");
+        }
+        for (auto const& filename : filenames) {
+            std::ifstream input(filename.c_str());
+            if (!input.good()) {
+                throw std::runtime_error("error in opening run '" + filename +
+                                         "'");
             }
+            if (LineHandler::value_t == value_type::count) {
+                std::string line;
+                std::getline(input, line);
+                m_num_lines += std::stoull(line);
+            } else {
+                m_num_lines += std::count(std::istreambuf_iterator<char>(input),
+                                          std::istreambuf_iterator<char>(),
+                                          '\n');
+            }
+        }
+    }
+
+    ~runs_merger() {
+        for (auto const& filename : m_filenames) {
+            std::remove(filename.c_str());
         }
+    }
 
-        os.close();
+    uint64_t num_lines() const {
+        return m_num_lines;
+    }
+
+    // NOTE: only one pass at a time is supported
+    iterator begin() {
+        m_heap.clear();
+        for (uint64_t i = 0; i != m_inputs.size(); ++i) {
+            auto& input = m_inputs[i];
+            input.close();
+            input.clear();
+            input.open(m_filenames[i].c_str());
+            if (LineHandler::value_t == value_type::count) {
+                std::getline(input, m_lines[i]);  // skip header
+            }
+            if (std::getline(input, m_lines[i])) {
+                m_records[i] = LineHandler::parse_line(m_lines[i]);
+                m_heap.push_back(i);
+            }
+        }
+        std::make_heap(m_heap.begin(), m_heap.end(), greater(this));
+        return iterator(this, 0);
+    }
+
+    iterator end() {
+        return iterator(nullptr, m_num_lines);
+    }
+
+private:
+    std::vector<std::string> m_filenames;
+    Comparator& m_comparator;
+    uint64_t m_num_lines;
+    std::vector<std::ifstream> m_inputs;
+    std::vector<std::string> m_lines;
+    std::vector<record_type> m_records;
+    std::vector<uint64_t> m_heap;
+
+    struct greater {
+        greater(runs_merger* m) : m_merger(m) {}
+        bool operator()(uint64_t i, uint64_t j) const {
+            return m_merger->m_comparator(m_merger->m_records[j],
+                                          m_merger->m_records[i]);
+        }
+
+    private:
+        runs_merger* m_merger;
+    };
+
+    void advance() {
+        std::pop_heap(m_heap.begin(), m_heap.end(), greater(this));
+        uint64_t i = m_heap.back();
+        if (std::getline(m_inputs[i], m_lines[i])) {
+            m_records[i] = LineHandler::parse_line(m_lines[i]);
+            std::push_heap(m_heap.begin(), m_heap.end(), greater(this));
+        } else {
+            m_heap.pop_back();
+        }
     }
 };
 
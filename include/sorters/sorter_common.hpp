@@ -7,17 +7,27 @@
 
 namespace tongrams {
 
+// NOTE:
+// word ids are assigned in the order of the vocabulary file or,
+// if frequency_order is true, by descending count
 void build_vocabulary(char const* vocab_filename, single_valued_mpht64& vocab,
-                      size_t bytes) {
+                      size_t bytes, bool frequency_order = false) {
     grams_counts_pool unigrams(bytes);
     unigrams.load_from<grams_gzparser>(vocab_filename);
     auto& unigrams_pool_index = unigrams.index();
     uint64_t n = unigrams_pool_index.size();
 
+    std::vector<uint64_t> order(n);
+    if (frequency_order) {
+        building_util::frequency_order(unigrams_pool_index, order);
+    } else {
+        std::iota(order.begin(), order.end(), 0);
+    }
+
     std::vector<byte_range> byte_ranges;
     byte_ranges.reserve(n);
-    for (auto const& record : unigrams_pool_index) {
-        byte_ranges.push_back(record.gram);
+    for (auto i : order) {
+        byte_ranges.push_back(unigrams_pool_index[i].gram);
     }
 
     compact_vector::builder cvb(n, util::ceil_log2(n + 1));
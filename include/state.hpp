@@ -1,21 +1,28 @@
 #pragma once
 
 #include "utils/util.hpp"
-#include "utils/circular_buffer.hpp"
+#include "utils/wyhash.hpp"
 
 namespace tongrams {
 // NOTE:
 // the template parameter Word is uint64_t for a trie model (ID of a word);
 // it is a uint8_t const* for a hash model (pointer to the last character of the
 // word).
-template <typename Word>
+// Order is the order of the model when known at compile time, so that
+// score() is specialized for it: its loops run for a constant number of
+// orders. With Order = 0 (default), the order is only known at run time.
+template <typename Word, uint64_t Order = 0>
 struct prob_model_state {
-    prob_model_state(uint8_t max_context_length)
-        : length(0), words(max_context_length), OOVs(0), m_pos(0) {
-        std::fill(m_curr_backoffs, m_curr_backoffs + max_context_length - 1,
-                  1.0);
-        std::fill(m_prev_backoffs, m_prev_backoffs + max_context_length - 1,
-                  1.0);
+    static_assert(Order <= global::max_order, "invalid order");
+    static const uint64_t capacity = Order ? Order : global::max_order;
+
+    prob_model_state(uint8_t max_context_length = Order)
+        : length(0), OOVs(0), m_pos(0) {
+        assert(max_context_length <= capacity);
+        (void)max_context_length;
+        std::fill(m_words, m_words + capacity, Word());
+        std::fill(m_curr_backoffs, m_curr_backoffs + capacity, 1.0);
+        std::fill(m_prev_backoffs, m_prev_backoffs + capacity, 1.0);
     }
 
     inline void advance() {
@@ -28,8 +35,18 @@ struct prob_model_state {
                          std::begin(m_prev_backoffs));
     }
 
+    // the last capacity words are kept, the most recent first
     inline void add_word(Word word) {
-        words.push_back(word);
+        for (uint64_t i = capacity - 1; i != 0; --i) {
+            m_words[i] = m_words[i - 1];
+        }
+        m_words[0] = word;
+    }
+
+    // the i-th last added word: word(0) is the last one
+    inline Word word(uint64_t i) const {
+        assert(i < capacity);
+        return m_words[i];
     }
 
     inline void add_backoff(float backoff) {
@@ -40,8 +57,12 @@ struct prob_model_state {
         return m_prev_backoffs[i];
     }
 
+    // the i-th backoff added since the last finalize()
+    inline float added_backoff(size_t i) const {
+        return m_curr_backoffs[i];
+    }
+
     inline void init() {
-        words.init();
         std::fill(m_prev_backoffs, m_prev_backoffs + length, 0.0);
         length = 0;
         OOVs = 0;
@@ -49,12 +70,59 @@ struct prob_model_state {
     }
 
     uint8_t length;
-    circular_buffer<Word> words;
     uint64_t OOVs;
 
 private:
     uint64_t m_pos;
-    float m_curr_backoffs[global::max_order];
-    float m_prev_backoffs[global::max_order];
+    Word m_words[capacity];
+    float m_curr_backoffs[capacity];
+    float m_prev_backoffs[capacity];
+};
+
+// NOTE:
+// the state of a hypothesis of a decoder, for the score() of trie_prob_lm
+// that maps an input state and a word to an output state (as KenLM does).
+// Unlike prob_model_state, it holds nothing but the longest matching
+// history of the last scored word: the ids of its words, the most recent
+// first, and their backoffs. So it is small, copied by value and can be
+// hashed and compared, to recombine the hypotheses with the same state.
+// Since the backoffs are determined by the words, they are not compared.
+// A default constructed state is the empty context.
+struct decoder_state {
+    static const uint64_t capacity = global::max_order - 1;
+
+    decoder_state() : length(0) {}
+
+    // the i-th last word of the history: word(0) is the last one
+    inline uint64_t word(uint64_t i) const {
+        assert(i < length);
+        return words[i];
+    }
+
+    inline float backoff(uint64_t i) const {
+        assert(i < length);
+        return backoffs[i];
+    }
+
+    uint64_t hash() const {
+        uint64_t h = length;
+        for (uint64_t i = 0; i != length; ++i) {
+            h = wy::mix(h ^ wy::secret[0], words[i] ^ wy::secret[1]);
+        }
+        return h;
+    }
+
+    bool operator==(decoder_state const& other) const {
+        return length == other.length and
+               std::equal(words, words + length, other.words);
+    }
+
+    bool operator!=(decoder_state const& other) const {
+        return !(*this == other);
+    }
+
+    uint64_t words[capacity];
+    float backoffs[capacity];
+    uint8_t length;
 };
 }  // namespace tongrams
@@ -1,7 +1,13 @@
 #pragma once
 
+#include <memory>
+
 #include "utils/util.hpp"
+#include "utils/bloom_filter.hpp"
+#include "utils/result_cache.hpp"
 #include "vectors/sorted_array.hpp"
+#include "sorters/sorter.hpp"
+#include "sorters/sorter_common.hpp"
 
 namespace tongrams {
 
@@ -9,81 +15,81 @@ template <typename Vocabulary, typename Mapper, typename Values, typename Ranks,
           typename Grams, typename Pointers>
 struct trie_count_lm {
     typedef sorted_array<Grams, Ranks, Pointers> sorted_array_type;
+    typedef result_cache<uint64_t> cache_type;
 
     struct builder {
         builder() {}
 
-        builder(const char* input_dir, uint8_t order, uint8_t remapping_order)
+        // NOTE:
+        // if unsorted is true, the n-grams are read from the unsorted
+        // files 'N-grams.gz', sorted in batches and merged on the fly
+        // while building each order, so that the fully sorted files
+        // are never written to disk.
+        // If also frequency_order is true, word ids are assigned by
+        // descending unigram count and the n-grams sorted accordingly
+        // (sorted input files can instead be prepared with
+        // sort_grams --freq_vocab).
+        // If filter_bits > 0, a Bloom filter with filter_bits bits per
+        // n-gram is built for each order, so that most of the n-grams
+        // not in the trie are rejected before the trie is accessed.
+        // The sorted batches of unsorted n-grams are written to tmp_dir.
+        builder(const char* input_dir, uint8_t order, uint8_t remapping_order,
+                bool unsorted = false, bool frequency_order = false,
+                uint64_t filter_bits = 0, const char* tmp_dir = ".")
             : m_input_dir(input_dir)
+            , m_tmp_dir(tmp_dir)
             , m_order(order)
-            , m_remapping_order(remapping_order) {
+            , m_remapping_order(remapping_order)
+            , m_unsorted(unsorted)
+            , m_frequency_order(frequency_order) {
             essentials::timer_type timer;
             timer.start();
 
             building_util::check_order(m_order);
             building_util::check_remapping_order(m_remapping_order);
+            if (m_frequency_order and !m_unsorted) {
+                throw std::invalid_argument(
+                    "frequency-ordered vocabulary requires unsorted input");
+            }
             m_arrays.reserve(m_order);
 
             typename Values::builder counts_builder(m_order);
 
-            for (uint8_t ord = 1; ord <= m_order; ++ord) {
-                std::string filename;
-                util::input_filename(m_input_dir, ord, filename);
-                util::check_filename(filename);
-                grams_gzparser gp(filename.c_str());
-
-                m_arrays.push_back(sorted_array_type(gp.num_lines()));
-                essentials::logger("Reading " + std::to_string(ord) +
-                                   "-grams counts");
-                for (auto const& l : gp) {
-                    counts_builder.eat_value(l.count);
+            if (m_unsorted) {
+                sort_and_build(counts_builder);
+            } else {
+                for (uint8_t ord = 1; ord <= m_order; ++ord) {
+                    std::string filename;
+                    util::input_filename(m_input_dir, ord, filename);
+                    util::check_filename(filename);
+                    grams_gzparser gp(filename.c_str());
+
+                    m_arrays.push_back(sorted_array_type(gp.num_lines()));
+                    essentials::logger("Reading " + std::to_string(ord) +
+                                       "-grams counts");
+                    eat_counts(filename, gp, counts_builder);
+                    counts_builder.build_sequence();
                 }
-                counts_builder.build_sequence();
-            }
 
-            essentials::logger("Building vocabulary");
-            build_vocabulary(counts_builder);
+                essentials::logger("Building vocabulary");
+                build_vocabulary(counts_builder);
 
-            for (uint8_t ord = 2; ord <= m_order; ++ord) {
-                std::string order_grams(std::to_string(ord) + "-grams");
-                std::string prv_order_filename;
-                std::string cur_order_filename;
-                util::input_filename(m_input_dir, ord - 1, prv_order_filename);
-                util::input_filename(m_input_dir, ord, cur_order_filename);
-
-                grams_gzparser gp_prv_order(prv_order_filename.c_str());
-                grams_gzparser gp_cur_order(cur_order_filename.c_str());
-
-                uint64_t n = gp_cur_order.num_lines();
-
-                typename sorted_array_type::builder sa_builder(
-                    n,
-                    m_vocab.size(),                // max_gram_id
-                    counts_builder.size(ord - 1),  // max_count_rank
-                    0);                            // quantization_bits not used
-
-                uint64_t num_pointers = gp_prv_order.num_lines() + 1;
-
-                // NOTE: we could use this to save pointers' space
-                // compact_vector::builder pointers(num_pointers,
-                // util::ceil_log2(n + 1));
-                std::vector<uint64_t> pointers;
-                pointers.reserve(num_pointers);
-
-                essentials::logger("Building " + order_grams);
-                build_ngrams(ord, pointers, gp_cur_order, gp_prv_order,
-                             counts_builder, sa_builder);
-                assert(pointers.back() == n);
-                assert(pointers.size() == num_pointers);
-                essentials::logger("Writing " + order_grams);
-                sa_builder.build(m_arrays[ord - 1], pointers, ord,
-                                 value_type::count);
-                essentials::logger("Writing pointers");
-                sorted_array_type::builder::build_pointers(m_arrays[ord - 2],
-                                                           pointers);
+                for (uint8_t ord = 2; ord <= m_order; ++ord) {
+                    std::string prv_order_filename;
+                    std::string cur_order_filename;
+                    util::input_filename(m_input_dir, ord - 1,
+                                         prv_order_filename);
+                    util::input_filename(m_input_dir, ord, cur_order_filename);
+
+                    grams_gzparser gp_prv_order(prv_order_filename.c_str());
+                    grams_gzparser gp_cur_order(cur_order_filename.c_str());
+                    build_order(ord, gp_cur_order, gp_prv_order,
+                                counts_builder);
+                }
             }
 
             counts_builder.build(m_distinct_counts);
+            if (filter_bits) build_filters(filter_bits);
 
             timer.stop();
             std::cout << "data structure built in " << timer.elapsed() / 1000000
@@ -96,6 +102,8 @@ struct trie_count_lm {
             trie.m_distinct_counts.swap(m_distinct_counts);
             trie.m_vocab.swap(m_vocab);
             trie.m_arrays.swap(m_arrays);
+            trie.m_filters.swap(m_filters);
+            if (trie.m_cache) trie.m_cache->clear();
             builder().swap(*this);
         }
 
@@ -105,16 +113,39 @@ struct trie_count_lm {
             m_distinct_counts.swap(other.m_distinct_counts);
             m_vocab.swap(other.m_vocab);
             m_arrays.swap(other.m_arrays);
+            m_filters.swap(other.m_filters);
         }
 
     private:
         const char* m_input_dir;
+        const char* m_tmp_dir;
         uint8_t m_order;
         uint8_t m_remapping_order;
+        bool m_unsorted;
+        bool m_frequency_order;
         Mapper m_mapper;
         Values m_distinct_counts;
         Vocabulary m_vocab;
         std::vector<sorted_array_type> m_arrays;
+        ngram_filters m_filters;
+
+        void build_filters(uint64_t bits_per_key) {
+            for (uint8_t ord = 1; ord <= m_order; ++ord) {
+                essentials::logger("Building " + std::to_string(ord) +
+                                   "-grams filter");
+                std::string filename;
+                if (m_unsorted) {
+                    util::unsorted_input_filename(m_input_dir, ord, filename);
+                } else {
+                    util::input_filename(m_input_dir, ord, filename);
+                }
+                grams_gzparser gp(filename.c_str());
+                blocked_bloom_filter::builder builder(gp.num_lines(),
+                                                      bits_per_key);
+                for (auto const& l : gp) builder.add(l.gram);
+                m_filters.push_back(builder);
+            }
+        }
 
         void build_vocabulary(typename Values::builder const& counts_builder) {
             size_t available_ram =
@@ -122,7 +153,7 @@ struct trie_count_lm {
             grams_counts_pool unigrams_pool(available_ram * 0.8);
 
             std::string filename;
-            util::input_filename(m_input_dir, 1, filename);
+            unigrams_filename(filename);
             unigrams_pool.load_from<grams_gzparser>(filename.c_str());
 
             auto& unigrams_pool_index = unigrams_pool.index();
@@ -134,7 +165,15 @@ struct trie_count_lm {
             typename sorted_array_type::builder sa_builder(
                 n, 0, counts_builder.size(0), 0);
 
-            for (auto const& record : unigrams_pool_index) {
+            std::vector<uint64_t> order(n);
+            if (m_frequency_order) {
+                building_util::frequency_order(unigrams_pool_index, order);
+            } else {
+                std::iota(order.begin(), order.end(), 0);
+            }
+
+            for (auto i : order) {
+                auto const& record = unigrams_pool_index[i];
                 bytes.push_back(record.gram);
                 uint64_t rank = counts_builder.rank(0, record.count);
                 sa_builder.add_count_rank(rank);
@@ -157,10 +196,137 @@ struct trie_count_lm {
             builder.build(m_vocab);
         }
 
-        template <typename T>
+        void unigrams_filename(std::string& filename) const {
+            if (m_unsorted) {
+                util::unsorted_input_filename(m_input_dir, 1, filename);
+            } else {
+                util::input_filename(m_input_dir, 1, filename);
+            }
+        }
+
+        typedef prefix_order_comparator(Vocabulary, count_record)
+            comparator_type;
+        typedef runs_merger<comparator_type, count_line_handler> merger_type;
+
+        void sort_and_build(typename Values::builder& counts_builder) {
+            // NOTE: unigrams are sorted only if ids are assigned by
+            // frequency, otherwise their order defines the vocabulary ids
+            std::string unigrams;
+            unigrams_filename(unigrams);
+            util::check_filename(unigrams);
+            {
+                grams_gzparser gp(unigrams.c_str());
+                m_arrays.push_back(sorted_array_type(gp.num_lines()));
+                essentials::logger("Reading 1-grams counts");
+                eat_counts(unigrams, gp, counts_builder);
+                counts_builder.build_sequence();
+            }
+
+            essentials::logger("Building vocabulary");
+            build_vocabulary(counts_builder);
+
+            comparator_type cmp(m_vocab);
+            std::vector<std::unique_ptr<merger_type>> mergers(m_order);
+            if (m_frequency_order) {
+                essentials::logger("Sorting 1-grams");
+                mergers[0] = sort_runs(unigrams, cmp, nullptr);
+            }
+
+            for (uint8_t ord = 2; ord <= m_order; ++ord) {
+                std::string filename;
+                util::unsorted_input_filename(m_input_dir, ord, filename);
+                util::check_filename(filename);
+                essentials::logger("Sorting " + std::to_string(ord) +
+                                   "-grams");
+                mergers[ord - 1] = sort_runs(filename, cmp, &counts_builder);
+                m_arrays.push_back(
+                    sorted_array_type(mergers[ord - 1]->num_lines()));
+                counts_builder.build_sequence();
+            }
+
+            for (uint8_t ord = 2; ord <= m_order; ++ord) {
+                auto& cur_order = *mergers[ord - 1];
+                if (mergers[ord - 2]) {
+                    build_order(ord, cur_order, *mergers[ord - 2],
+                                counts_builder);
+                    mergers[ord - 2].reset();  // remove runs
+                } else {
+                    grams_gzparser gp_prv_order(unigrams.c_str());
+                    build_order(ord, cur_order, gp_prv_order, counts_builder);
+                }
+            }
+        }
+
+        // NOTE: if counts_builder is not null, counts are collected
+        // while reading the grams
+        std::unique_ptr<merger_type> sort_runs(
+            std::string const& filename, comparator_type& cmp,
+            typename Values::builder* counts_builder) {
+            size_t available_ram =
+                sysconf(_SC_PAGESIZE) * sysconf(_SC_PHYS_PAGES);
+            grams_gzparser gp(filename.c_str());
+            uint64_t n = gp.num_lines();
+            grams_counts_pool pool(n, available_ram * 0.8);
+            sorter<comparator_type, count_line_handler> s(n, cmp, "",
+                                                          m_tmp_dir);
+            auto begin = gp.begin();
+            auto const end = gp.end();
+            while (begin != end) {
+                for (; begin != end; ++begin) {
+                    auto const& l = *begin;
+                    if (!pool.append(l)) break;
+                    if (counts_builder) counts_builder->eat_value(l.count);
+                }
+                auto& grams_index = pool.index();
+                if (grams_index.empty()) {
+                    throw std::runtime_error(
+                        "max available memory pool excedeed");
+                }
+                s.sort(grams_index.begin(), grams_index.end());
+                pool.clear();
+            }
+            return std::unique_ptr<merger_type>(
+                new merger_type(s.release_runs(), cmp));
+        }
+
+        template <typename CurOrderGrams, typename PrvOrderGrams>
+        void build_order(uint8_t ord, CurOrderGrams& gp_cur_order,
+                         PrvOrderGrams& gp_prv_order,
+                         typename Values::builder const& counts_builder) {
+            std::string order_grams(std::to_string(ord) + "-grams");
+            uint64_t n = gp_cur_order.num_lines();
+
+            typename sorted_array_type::builder sa_builder(
+                n,
+                m_vocab.size(),                // max_gram_id
+                counts_builder.size(ord - 1),  // max_count_rank
+                0);                            // quantization_bits not used
+
+            uint64_t num_pointers = gp_prv_order.num_lines() + 1;
+
+            // NOTE: we could use this to save pointers' space
+            // compact_vector::builder pointers(num_pointers,
+            // util::ceil_log2(n + 1));
+            std::vector<uint64_t> pointers;
+            pointers.reserve(num_pointers);
+
+            essentials::logger("Building " + order_grams);
+            build_ngrams(ord, pointers, gp_cur_order, gp_prv_order,
+                         counts_builder, sa_builder);
+            assert(pointers.back() == n);
+            assert(pointers.size() == num_pointers);
+            essentials::logger("Writing " + order_grams);
+            sa_builder.build(m_arrays[ord - 1], pointers, ord,
+                             value_type::count);
+            essentials::logger("Writing pointers");
+            sorted_array_type::builder::build_pointers(m_arrays[ord - 2],
+                                                       pointers);
+        }
+
+        template <typename T, typename CurOrderGrams, typename PrvOrderGrams>
         void build_ngrams(uint8_t order, T& pointers,
-                          grams_gzparser& gp_cur_order,
-                          grams_gzparser& gp_prv_order,
+                          CurOrderGrams& gp_cur_order,
+                          PrvOrderGrams& gp_prv_order,
                           typename Values::builder const& counts_builder,
                           typename sorted_array_type::builder& sa_builder) {
             assert(order > 1);
@@ -168,6 +334,7 @@ struct trie_count_lm {
             identity_adaptor adaptor;
 
             uint64_t pointer = 0;
+            uint64_t prv_token_id = 0;
             auto prv_order_begin = gp_prv_order.begin();
             auto prv_order_end = gp_prv_order.end();
 
@@ -206,10 +373,14 @@ struct trie_count_lm {
                         << "\t'" << std::string(pattern.first, pattern.second)
                         << "'"
                         << " should have been found among " << int(order - 1)
-                        << "-grams" << std::endl;
+                        << "-grams\n";
+                    std::cerr << "(or the files are not sorted with the same "
+                              << "vocabulary ids, e.g., only some of them with "
+                              << "sort_grams --freq_vocab)" << std::endl;
                     exit(1);
                 }
 
+                bool first_child = pointer == pointers.back();
                 ++pointer;
 
                 uint64_t token_id = m_vocab.lookup(token, adaptor);
@@ -234,6 +405,23 @@ struct trie_count_lm {
                     }
                 }
 
+                // NOTE: the ids of the children of a context must be
+                // increasing, i.e., the grams must be sorted with the ids
+                // given by the order of the uni-gram file
+                if (!first_child and token_id <= prv_token_id) {
+                    std::cerr << int(order) << "-grams file is not sorted "
+                              << "in prefix order with the vocabulary of the "
+                              << "uni-gram file:\n";
+                    std::cerr << "\t'" << std::string(gram.first, gram.second)
+                              << "' at line " << pointer - 1
+                              << " should precede its previous gram\n";
+                    std::cerr << "(if the grams were sorted with sort_grams "
+                              << "--freq_vocab, the uni-gram file must be "
+                              << "sorted with it too)" << std::endl;
+                    exit(1);
+                }
+                prv_token_id = token_id;
+
                 sa_builder.add_gram(token_id);
                 uint64_t rank = counts_builder.rank(order - 1, l.count);
                 sa_builder.add_count_rank(rank);
@@ -250,26 +438,26 @@ struct trie_count_lm {
 
     template <typename T, typename Adaptor>
     uint64_t lookup(T gram, Adaptor adaptor) {
-        static uint64_t word_ids[global::max_order];
-        uint64_t o = m_mapper.map_query(adaptor(gram), word_ids, &m_vocab,
-                                        &m_arrays.front(), m_remapping_order);
-
-        if (o == global::not_found or o > order()) {
-            return global::not_found;
+        byte_range br = adaptor(gram);
+        if (!m_cache) return uncached_lookup(br);
+        uint64_t key = cache_type::hash(br);
+        uint64_t count;
+        if (!m_cache->find(key, count)) {
+            count = uncached_lookup(br);
+            m_cache->insert(key, count);
         }
+        return count;
+    }
 
-        pointer_range r;
-        uint64_t pos = word_ids[0];
-        for (uint64_t i = 1; i <= o; ++i) {
-            r = m_arrays[i - 1].range(pos);
-            pos = m_arrays[i].position(r, word_ids[i]);
-            if (pos == global::not_found) {
-                return global::not_found;
-            }
-        }
+    // NOTE: the results of lookup(), also of the grams not found, are
+    // kept in a cache of num_slots slots, shared by the threads using
+    // the model; 0 removes the cache
+    void set_cache(uint64_t num_slots) {
+        m_cache.reset(num_slots ? new cache_type(num_slots) : nullptr);
+    }
 
-        uint64_t count_rank = m_arrays[o].count_rank(pos);
-        return m_distinct_counts.access(o, count_rank);
+    cache_type const* cache() const {
+        return m_cache.get();
     }
 
     inline uint64_t order() const {
@@ -280,6 +468,12 @@ struct trie_count_lm {
         return uint64_t(m_remapping_order);
     }
 
+    // NOTE: the grams are searched by the ids of their words,
+    // so a gram not in the trie is never found
+    double false_positive_rate() const {
+        return 0.0;
+    }
+
     void print_stats(size_t bytes) const;
 
     uint64_t size() const {
@@ -295,22 +489,30 @@ struct trie_count_lm {
         essentials::save_pod(os, m_remapping_order);
         m_distinct_counts.save(os);
         m_vocab.save(os);
+        m_filters.save(os);
         m_arrays.front().save(os, 1, value_type::count);
         for (uint8_t order = 1; order < m_order; ++order) {
             m_arrays[order].save(os, order + 1, value_type::count);
         }
     }
 
-    void load(std::istream& is) {
+    // NOTE: the arrays of order > max_order are not read, and the
+    // grams of such orders are then reported as not found
+    void load(std::istream& is, uint64_t max_order = global::max_order) {
         essentials::load_pod(is, m_order);
         essentials::load_pod(is, m_remapping_order);
         m_distinct_counts.load(is, m_order);
         m_vocab.load(is);
+        m_filters.load(is);
+        m_order = std::min<uint64_t>(m_order, max_order);
+        m_filters.truncate(m_order);
         m_arrays.resize(m_order);
-        m_arrays.front().load(is, 1, value_type::count);
-        for (uint8_t order = 1; order < m_order; ++order) {
-            m_arrays[order].load(is, order + 1, value_type::count);
-        }
+        memory::load_sections(
+            is, m_arrays.begin(), m_arrays.end(),
+            [](std::istream& is, sorted_array_type& a, uint64_t i) {
+                a.load(is, i + 1, value_type::count);
+            });
+        if (m_cache) m_cache->clear();
     }
 
 private:
@@ -320,6 +522,41 @@ private:
     Values m_distinct_counts;
     Vocabulary m_vocab;
     std::vector<sorted_array_type> m_arrays;
+    ngram_filters m_filters;
+    std::unique_ptr<cache_type> m_cache;
+
+    uint64_t uncached_lookup(byte_range br) {
+        if (!m_filters.empty() and !m_filters.contains(br)) {
+            return global::not_found;
+        }
+
+        // NOTE: a query of more words than the loaded orders must not be
+        // mapped, since its remapped ids would be searched among them
+        if (uint64_t(std::count(br.first, br.second, ' ')) >= order()) {
+            return global::not_found;
+        }
+
+        uint64_t word_ids[global::max_order];
+        uint64_t o = m_mapper.map_query(br, word_ids, &m_vocab,
+                                        &m_arrays.front(), m_remapping_order);
+
+        if (o == global::not_found) {
+            return global::not_found;
+        }
+
+        pointer_range r;
+        uint64_t pos = word_ids[0];
+        for (uint64_t i = 1; i <= o; ++i) {
+            r = m_arrays[i - 1].range(pos);
+            pos = m_arrays[i].position(r, word_ids[i]);
+            if (pos == global::not_found) {
+                return global::not_found;
+            }
+        }
+
+        uint64_t count_rank = m_arrays[o].count_rank(pos);
+        return m_distinct_counts.access(o, count_rank);
+    }
 };
 
 }  // namespace tongrams
@@ -1,6 +1,12 @@
 #pragma once
 
+#include <atomic>
+#include <memory>
+
 #include "utils/util.hpp"
+#include "utils/result_cache.hpp"
+#include "utils/word_cache.hpp"
+#include "utils/context_cache.hpp"
 #include "state.hpp"
 #include "utils/iterators.hpp"
 #include "vectors/sorted_array.hpp"
@@ -115,6 +121,8 @@ struct trie_prob_lm {
             trie.m_backoffs_averages.swap(m_backoffs_averages);
             trie.m_vocab.swap(m_vocab);
             trie.m_arrays.swap(m_arrays);
+            trie.m_id = next_id();
+            if (trie.m_cache) trie.m_cache->clear();
             builder().swap(*this);
         }
 
@@ -294,15 +302,76 @@ struct trie_prob_lm {
     trie_prob_lm()
         : m_order(0)
         , m_remapping_order(0)
-        , m_unk_prob(global::default_unk_prob) {}
+        , m_unk_prob(global::default_unk_prob)
+        , m_id(next_id()) {}
 
     typedef prob_model_state<uint64_t> state_type;
 
+    // NOTE: the outcome of STEP (1) of score() for a word: it only depends
+    // on the word and on its last min(state.length, order() - 1) words
+    struct score_entry {
+        float prob;
+        float backoffs[global::max_order - 1];
+        uint8_t order_m1;
+        uint8_t history_len;
+    };
+    typedef result_cache<score_entry> cache_type;
+
+    // NOTE: the outcomes of STEP (1) of score() are kept in a cache of
+    // num_slots slots, shared by the threads using the model; 0 removes
+    // the cache
+    void set_cache(uint64_t num_slots) {
+        m_cache.reset(num_slots ? new cache_type(num_slots) : nullptr);
+    }
+
+    cache_type const* cache() const {
+        return m_cache.get();
+    }
+
     state_type state() {
         return state_type(order());
     }
 
-    float score(state_type& state, byte_range const word, bool& is_OOV);
+    // NOTE: a state for Order == order() selects the score()
+    // specialized for the order of the model
+    template <uint64_t Order>
+    prob_model_state<uint64_t, Order> state() {
+        assert(Order == order());
+        return prob_model_state<uint64_t, Order>(order());
+    }
+
+    template <uint64_t Order>
+    float score(prob_model_state<uint64_t, Order>& state,
+                byte_range const word, bool& is_OOV);
+
+    // NOTE: a word for the score() of a decoder: its id and its packed
+    // unigram probability and backoff, or a pair of global::not_found
+    // if it is not in the vocabulary. A decoder looks up its words once.
+    uint64_pair word(byte_range const w) const {
+        return m_vocab.lookup_pair(w, identity_adaptor());
+    }
+
+    // NOTE: the state of the context of a sentence begin, i.e., "<s>",
+    // or the empty context if "<s>" is not in the vocabulary
+    decoder_state begin_sentence_state() const {
+        static const char begin_sentence[] = "<s>";
+        auto begin = reinterpret_cast<uint8_t const*>(begin_sentence);
+        decoder_state state;
+        uint64_pair w = word(byte_range(begin, begin + 3));
+        if (w.first != global::not_found) {
+            float prob;
+            bits::unpack(w.second, prob, state.backoffs[0]);
+            state.words[0] = w.first;
+            state.length = 1;
+        }
+        return state;
+    }
+
+    // NOTE: the score() of a decoder: the log10 probability of word after
+    // the context of in, whose extension with word is written to out
+    // (that must not be in), so that in can be extended by other words
+    float score(decoder_state const& in, uint64_pair const word,
+                decoder_state& out);
 
     inline uint64_t order() const {
         return uint64_t(m_order);
@@ -343,10 +412,14 @@ struct trie_prob_lm {
         m_backoffs_averages.load(is, m_order - 2);
         m_vocab.load(is);
         m_arrays.resize(m_order);
-        m_arrays.front().load(is, 1, value_type::none);
-        for (uint8_t order_m1 = 1; order_m1 < m_order; ++order_m1) {
-            m_arrays[order_m1].load(is, order_m1 + 1, value_type::prob_backoff);
-        }
+        memory::load_sections(
+            is, m_arrays.begin(), m_arrays.end(),
+            [](std::istream& is, sorted_array_type& a, uint64_t i) {
+                a.load(is, i + 1,
+                       i ? value_type::prob_backoff : value_type::none);
+            });
+        m_id = next_id();
+        if (m_cache) m_cache->clear();
     }
 
 private:
@@ -358,6 +431,76 @@ private:
     Values m_backoffs_averages;
     Vocabulary m_vocab;
     std::vector<sorted_array_type> m_arrays;
+    std::unique_ptr<cache_type> m_cache;
+    uint64_t m_id;  // changed whenever the model is built or loaded
+
+    static uint64_t next_id() {
+        static std::atomic<uint64_t> id(0);
+        return ++id;
+    }
+
+    // NOTE: the caches of score() of the calling thread; since they
+    // hold the word ids of a model, they are cleared whenever the thread
+    // scores with another model than the one that filled them
+    struct score_caches {
+        score_caches() : model_id(0) {}
+        uint64_t model_id;
+        word_cache words;
+        context_cache contexts;
+    };
+
+    score_caches& local_caches() const {
+        thread_local score_caches caches;
+        if (caches.model_id != m_id) {
+            caches.words.clear();
+            caches.contexts.clear();
+            caches.model_id = m_id;
+        }
+        return caches;
+    }
+
+    // NOTE: search the word id among the children r of its context in the
+    // order_m1-th array: if found, its probability and, if not last, its
+    // backoff and the range of its children, in r, are returned
+    bool search(uint64_t order_m1, uint64_t id, uint64_t prev_id,
+                uint64_t prev_prev_id, bool last, pointer_range& r,
+                float& prob, float& backoff) {
+        if (Mapper::context_remapping && order_m1 > m_remapping_order) {
+            id = m_mapper.map_id(
+                prev_id,
+                prev_prev_id,  // pass the two parent ids for remapping
+                id, &m_arrays.front(), m_remapping_order);
+        }
+
+        uint64_t pos = m_arrays[order_m1].position(r, id);
+        if (pos == global::not_found) {
+            return false;
+        }
+
+        uint64_t probs_quantization_bits =
+            m_probs_averages.quantization_bits(order_m1 - 1);
+        uint64_t mask = (uint64_t(1) << probs_quantization_bits) - 1;
+        uint64_t prob_backoff_rank = m_arrays[order_m1].prob_backoff_rank(pos);
+        uint64_t prob_rank = prob_backoff_rank & mask;
+        uint64_t backoff_rank = prob_backoff_rank >> probs_quantization_bits;
+        prob = m_probs_averages.access(order_m1 - 1, prob_rank);
+
+        if (!last) {
+            backoff = m_backoffs_averages.access(order_m1 - 1, backoff_rank);
+            r = m_arrays[order_m1].range(pos);
+        }
+        return true;
+    }
+
+    // NOTE: words(i) is the i-th last word, words(0) the scored one
+    template <typename Words>
+    static uint64_t context_key(Words words, uint64_t length) {
+        uint64_t key = length;
+        for (uint64_t i = 0; i <= length; ++i) {
+            key = wy::mix(key ^ wy::secret[0], words(i) ^ wy::secret[1]);
+        }
+        return key;
+    }
 };
 
 }  // namespace tongrams
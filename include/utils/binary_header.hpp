@@ -5,33 +5,40 @@
 namespace tongrams {
 
 namespace version {
-static const uint8_t version_number = 10;  // xy read as 'x.y'
+static const uint8_t version_number = 11;  // xy read as 'x.y'
 
-std::string lib_version() {
-    std::string v = std::to_string(version_number / 10) + "." +
-                    std::to_string(version_number % 10);
+// NOTE: since version 1.1, the header of a binary file is followed by
+// this magic number and the version of the library that wrote it,
+// so that a file of another version is rejected when loaded
+static const uint32_t magic = 0x6d72676e;  // "ngrm"
+
+std::string lib_version(uint8_t number = version_number) {
+    std::string v =
+        std::to_string(number / 10) + "." + std::to_string(number % 10);
     return v;
 }
 }  // namespace version
 
 struct binary_header {
     /*
-                            2 bits           2 bits      1 bit      2 bits
-                      ---------------------------------------------------------
-        trie_count    |   ranks_type |remapping_order|value_t|data_structure_t|
-                      ---------------------------------------------------------
-                  ------------------------------------------
-        trie_prob |remapping_order|value_t|data_structure_t|
-                  ------------------------------------------
-
-
-                           1 bits      1 bit      2 bits
-                      -----------------------------------------
-        hash_count    |hash_key_bytes|value_t|data_structure_t|
-                      -----------------------------------------
-                    -----------------------------------------
-        hash_prob   |hash_key_bytes|value_t|data_structure_t|
-                    -----------------------------------------
+                    1 bit      2 bits           2 bits      1 bit      2 bits
+                  --------------------------------------------------------------
+    trie_count    |hasher_t|ranks_type|remapping_order|value_t|data_structure_t|
+                  --------------------------------------------------------------
+                  --------------------------------------------------------
+    trie_prob     |hasher_t| 0 |remapping_order|value_t|data_structure_t|
+                  --------------------------------------------------------
+
+
+                 1 bit   1 bit   1 bit  1 bit 1 bit 1 bit       2 bits
+               -------------------------------------------------------------
+    hash_count |hasher_t|keys_t|table_t|mphf_t|hkb|value_t|data_structure_t|
+               -------------------------------------------------------------
+               -------------------------------------------------------------
+    hash_prob  |hasher_t|keys_t|table_t|mphf_t|hkb|value_t|data_structure_t|
+               -------------------------------------------------------------
+
+    where hkb = hash_key_bytes / 4 - 1.
     */
 
     static const int invalid = -1;
@@ -41,7 +48,11 @@ struct binary_header {
         , value_t(invalid)
         , remapping_order(invalid)
         , hash_key_bytes(invalid)
-        , ranks_t(invalid) {}
+        , ranks_t(invalid)
+        , hasher_t(hasher_type::jenkins)
+        , mphf_t(mphf_type::hypergraph)
+        , table_t(table_type::mph)
+        , keys_t(key_type::string_keys) {}
 
     static bool is_invalid(int param) {
         return param == invalid;
@@ -68,6 +79,15 @@ struct binary_header {
         if (data_structure_t == data_structure_type::hash) {
             check_is_valid(hash_key_bytes);
             header |= (hash_key_bytes / 4 - 1) << position;
+            ++position;
+            check_is_valid(mphf_t);
+            header |= mphf_t << position;
+            ++position;
+            check_is_valid(table_t);
+            header |= table_t << position;
+            ++position;
+            check_is_valid(keys_t);
+            header |= keys_t << position;
         } else {
             check_is_valid(remapping_order);
             header |= remapping_order << position;
@@ -78,6 +98,10 @@ struct binary_header {
             }
         }
 
+        // NOTE: the base hasher always takes the highest bit
+        check_is_valid(hasher_t);
+        header |= hasher_t << 7;
+
         return header;
     }
 
@@ -88,6 +112,10 @@ struct binary_header {
         }
 
         std::string model_string_type = "";
+        int hasher_t = header >> 7;
+        int mphf_t = mphf_type::hypergraph;
+        int keys_t = key_type::string_keys;
+        header &= 127;
         int data_structure_t = header & 3;
         switch (data_structure_t) {
             case data_structure_type::hash:
@@ -99,6 +127,9 @@ struct binary_header {
             case data_structure_type::pef_trie:
                 model_string_type += "pef_trie";
                 break;
+            case data_structure_type::cl_trie:
+                model_string_type += "cl_trie";
+                break;
             default:
                 assert(false);
         }
@@ -114,17 +145,44 @@ struct binary_header {
         if (data_structure_t == data_structure_type::hash) {
             int hash_key_bytes = ((header & 1) + 1) * 4;
             model_string_type += hash_key_bytes == 4 ? "32" : "64";
+            header >>= 1;
+            mphf_t = header & 1;
+            header >>= 1;
+            int table_t = header & 1;
+            if (table_t == table_type::cuckoo) {
+                model_string_type = hash_key_bytes == 4 ? "cuckoo32"
+                                                        : "cuckoo64";
+            }
+            header >>= 1;
+            keys_t = header & 1;
             if (verbose) {
                 std::cout << "hash_key_bytes: " << hash_key_bytes << "\n";
+                if (table_t == table_type::cuckoo) {
+                    std::cout << "table: cuckoo\n";
+                } else {
+                    std::cout << "mphf: "
+                              << (mphf_t == mphf_type::pthash ? "pthash"
+                                                              : "hypergraph")
+                              << "\n";
+                }
+                std::cout << "keys: "
+                          << (keys_t == key_type::id_keys ? "word ids"
+                                                          : "strings")
+                          << "\n";
             }
         } else {
             int remapping_order = header & 3;
             header >>= 2;
             if (remapping_order) {
-                if (data_structure_t == data_structure_type::ef_trie) {
-                    model_string_type = "ef_rtrie";
-                } else {
-                    model_string_type = "pef_rtrie";
+                switch (data_structure_t) {
+                    case data_structure_type::ef_trie:
+                        model_string_type = "ef_rtrie";
+                        break;
+                    case data_structure_type::pef_trie:
+                        model_string_type = "pef_rtrie";
+                        break;
+                    default:  // no remapped cache-line trie
+                        model_string_type = "cl_rtrie";
                 }
             }
 
@@ -132,7 +190,9 @@ struct binary_header {
                 std::cout << "remapping order: " << remapping_order << "\n";
             }
 
-            if (value_t == value_type::count) {
+            // NOTE: the cache-line trie stores ranks within its blocks
+            if (value_t == value_type::count and
+                data_structure_t != data_structure_type::cl_trie) {
                 int ranks_t = header & 3;
                 switch (ranks_t) {
                     case ranks_type::IC:
@@ -162,6 +222,22 @@ struct binary_header {
             }
         }
 
+        if (hasher_t == hasher_type::wyhash) {
+            model_string_type += "_wyhash";
+        }
+        if (mphf_t == mphf_type::pthash) {
+            model_string_type += "_pthash";
+        }
+        if (keys_t == key_type::id_keys) {
+            model_string_type += "_ids";
+        }
+        if (verbose) {
+            std::cout << "base hasher: "
+                      << (hasher_t == hasher_type::wyhash ? "wyhash"
+                                                          : "jenkins")
+                      << "\n";
+        }
+
         switch (value_t) {
             case value_type::count:
                 model_string_type += "_count_lm";
@@ -193,6 +269,10 @@ struct binary_header {
     int remapping_order;
     int hash_key_bytes;
     int ranks_t;
+    int hasher_t;
+    int mphf_t;
+    int table_t;
+    int keys_t;
 };
 
 }  // namespace tongrams
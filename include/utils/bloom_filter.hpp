@@ -0,0 +1,203 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#include "utils/util.hpp"
+#include "utils/memory.hpp"
+#include "utils/wyhash.hpp"
+
+namespace tongrams {
+
+// NOTE:
+// blocked Bloom filter: the k bits of a key are all set within one
+// cache-line block, chosen by the key hash, so that testing a key
+// touches a single cache line. It uses bits_per_key bits and
+// k = bits_per_key * ln(2) hash functions per key, with a false positive rate
+// slightly higher than that of a standard Bloom filter (about 1% with
+// 10 bits per key). An empty filter (no blocks) contains every key.
+struct blocked_bloom_filter {
+    struct alignas(64) block {
+        uint64_t words[8];
+    };
+
+    static const uint64_t block_bits = sizeof(block) * 8;
+    static const uint64_t max_bits_per_key = 32;
+    static const uint64_t seed = 1234567890;
+
+    static inline uint64_t hash(byte_range br) {
+        return wy::hash(br.first, br.second - br.first, seed);
+    }
+
+    struct builder {
+        builder() : m_num_hashes(0) {}
+
+        builder(uint64_t n, uint64_t bits_per_key) {
+            if (bits_per_key == 0 or bits_per_key > max_bits_per_key) {
+                std::cerr << "Error: bits per key must be > 0 and <= "
+                          << max_bits_per_key << "." << std::endl;
+                std::abort();
+            }
+            m_num_hashes = std::max<uint64_t>(
+                1, std::lround(bits_per_key * std::log(2.0)));
+            uint64_t num_blocks = std::max<uint64_t>(
+                1, util::ceil_div(n * bits_per_key, block_bits));
+            m_blocks.resize(num_blocks, block{{0}});
+        }
+
+        void add(byte_range br) {
+            uint64_t h = hash(br);
+            block& b = m_blocks[range(h, m_blocks.size())];
+            positions p(h);
+            for (uint64_t i = 0; i != m_num_hashes; ++i, p.next()) {
+                b.words[p.pos >> 6] |= uint64_t(1) << (p.pos & 63);
+            }
+        }
+
+        void build(blocked_bloom_filter& filter) {
+            filter.m_num_hashes = m_num_hashes;
+            filter.m_blocks.swap(m_blocks);
+            builder().swap(*this);
+        }
+
+        void swap(builder& other) {
+            std::swap(m_num_hashes, other.m_num_hashes);
+            m_blocks.swap(other.m_blocks);
+        }
+
+    private:
+        uint64_t m_num_hashes;
+        std::vector<block> m_blocks;
+    };
+
+    blocked_bloom_filter() : m_num_hashes(0) {}
+
+    inline bool empty() const {
+        return m_blocks.empty();
+    }
+
+    // false if br was certainly not added
+    inline bool contains(byte_range br) const {
+        if (empty()) return true;
+        uint64_t h = hash(br);
+        block const& b = m_blocks[range(h, m_blocks.size())];
+        positions p(h);
+        uint64_t found = 1;
+        for (uint64_t i = 0; i != m_num_hashes; ++i, p.next()) {
+            found &= b.words[p.pos >> 6] >> (p.pos & 63);
+        }
+        return found;
+    }
+
+    uint64_t num_hashes() const {
+        return m_num_hashes;
+    }
+
+    size_t bytes() const {
+        return essentials::vec_bytes(m_blocks) + sizeof(m_num_hashes);
+    }
+
+    void swap(blocked_bloom_filter& other) {
+        std::swap(m_num_hashes, other.m_num_hashes);
+        m_blocks.swap(other.m_blocks);
+    }
+
+    void save(std::ostream& os) const {
+        essentials::save_pod(os, m_num_hashes);
+        essentials::save_vec(os, m_blocks);
+    }
+
+    void load(std::istream& is) {
+        essentials::load_pod(is, m_num_hashes);
+        memory::load_vec(is, m_blocks);
+    }
+
+private:
+    uint64_t m_num_hashes;
+    std::vector<block> m_blocks;
+
+    // map a hash to [0, n) with a multiplication instead of a modulo
+    static inline uint64_t range(uint64_t hash, uint64_t n) {
+        return (__uint128_t(hash) * n) >> 64;
+    }
+
+    // NOTE: the positions within a block are generated by double hashing
+    // from a second hash; an odd step makes them distinct
+    struct positions {
+        positions(uint64_t hash) {
+            uint64_t h = wy::mix(hash, wy::secret[1]);
+            pos = h & (block_bits - 1);
+            step = (h >> 32) | 1;
+        }
+
+        inline void next() {
+            pos = (pos + step) & (block_bits - 1);
+        }
+
+        uint64_t pos;
+        uint64_t step;
+    };
+};
+
+// NOTE:
+// the filters of a model, one per order: the n-grams of order i + 1 are
+// added to the i-th one. It is empty if the model has no filters.
+struct ngram_filters {
+    inline bool empty() const {
+        return m_filters.empty();
+    }
+
+    // false if br is certainly not an n-gram of the model,
+    // as it is whenever it has more words than filters
+    inline bool contains(byte_range br) const {
+        uint64_t order_m1 = std::count(br.first, br.second, ' ');
+        return order_m1 < m_filters.size() and
+               m_filters[order_m1].contains(br);
+    }
+
+    void push_back(blocked_bloom_filter::builder& builder) {
+        m_filters.emplace_back();
+        builder.build(m_filters.back());
+    }
+
+    // keep the filters of the first max_order orders
+    void truncate(uint64_t max_order) {
+        if (m_filters.size() > max_order) m_filters.resize(max_order);
+    }
+
+    uint64_t size() const {
+        return m_filters.size();
+    }
+
+    blocked_bloom_filter const& operator[](uint64_t i) const {
+        return m_filters[i];
+    }
+
+    size_t bytes() const {
+        size_t bytes = sizeof(uint64_t);
+        for (auto const& f : m_filters) bytes += f.bytes();
+        return bytes;
+    }
+
+    void swap(ngram_filters& other) {
+        m_filters.swap(other.m_filters);
+    }
+
+    void save(std::ostream& os) const {
+        uint64_t n = m_filters.size();
+        essentials::save_pod(os, n);
+        for (auto const& f : m_filters) f.save(os);
+    }
+
+    void load(std::istream& is) {
+        uint64_t n;
+        essentials::load_pod(is, n);
+        m_filters.resize(n);
+        for (auto& f : m_filters) f.load(is);
+    }
+
+private:
+    std::vector<blocked_bloom_filter> m_filters;
+};
+
+}  // namespace tongrams
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+
+#include "utils/util.hpp"
+#include "utils/wyhash.hpp"
+
+namespace tongrams {
+
+// NOTE:
+// small direct-mapped cache of a single thread (see trie_prob_lm::score())
+// memoizing the searches of the lowest orders of the reversed
+// trie of trie_prob_lm: it maps a word and its last k words, by a hash of
+// their ids, to the outcome of the search of the (k + 1)-th order, i.e.,
+// whether the (k + 1)-gram exists, its probability and backoff and the
+// range of its children. Consecutive sentences and even consecutive
+// words share most of their low-order contexts, whose searches are the
+// most expensive ones, among the children of frequent words.
+// Two contexts with the same 64-bit hash are confused, with probability
+// 2^-63 per pair. The slots are allocated by the first lookup.
+struct context_cache {
+    static const uint64_t num_slots = 1024;  // 40 KB
+
+    // the searches of the orders 2, ..., max_order_m1 + 1 are memoized
+    static const uint64_t max_order_m1 = 2;
+
+    struct entry {
+        uint64_t key;
+        pointer_range range;
+        float prob;
+        float backoff;
+        bool found;
+    };
+
+    // the key of the context of key extended by one (older) word
+    static inline uint64_t extend(uint64_t key, uint64_t word_id) {
+        // NOTE: an odd key, since 0 marks an empty entry
+        return wy::mix(key ^ wy::secret[0], word_id ^ wy::secret[1]) | 1;
+    }
+
+    // the entry of key: it is for another key if key is not cached
+    inline entry& slot(uint64_t key) {
+        if (m_entries.empty()) {
+            m_entries.resize(num_slots, {0, {0, 0}, 0.0, 0.0, false});
+        }
+        return m_entries[(key >> 1) & (num_slots - 1)];
+    }
+
+    // the entries are allocated again by the next lookup
+    void clear() {
+        m_entries.clear();
+    }
+
+private:
+    std::vector<entry> m_entries;
+};
+
+}  // namespace tongrams
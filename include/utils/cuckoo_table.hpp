@@ -0,0 +1,405 @@
+#pragma once
+
+#include <random>
+#include <cmath>
+
+#include "utils/util.hpp"
+#include "utils/memory.hpp"
+#include "vectors/compact_vector.hpp"
+
+namespace tongrams {
+
+// NOTE:
+// open-addressing alternative to single_valued_mpht: a bucketized cuckoo
+// hash table whose buckets are cache lines of (fingerprint, value) slots.
+// Every key can be stored in either of two buckets, so a lookup touches
+// at most two cache lines (the second one is prefetched) and needs no
+// access to a hash function representation. Slots are filled from the
+// beginning of a bucket and a zero fingerprint marks an empty slot.
+// The price is the space of the empty slots: buckets are loaded up to
+// max_load of their capacity.
+// Keys whose fingerprint collides with that of a key sharing one of their
+// buckets would be confused with it, so they are moved to a small stash,
+// searched first, that stores their full 64-bit hashes.
+template <typename BaseHasher, uint64_t KeyBits = 64>
+struct cuckoo_table {
+    typedef typename BaseHasher::hash_t hash_t;
+    typedef typename BaseHasher::hash_triple_t hash_triple_t;
+    static const uint64_t hash_bits = KeyBits;
+
+    static_assert(sizeof(hash_t) == 8, "cuckoo_table needs 64-bit hashes");
+    static_assert(KeyBits > 0 and KeyBits <= 64, "invalid key width");
+
+    struct alignas(64) bucket {
+        uint64_t words[8];
+    };
+
+    static const uint64_t bucket_bits = sizeof(bucket) * 8;
+
+    struct builder {
+        builder()
+            : m_key_width(KeyBits)
+            , m_width(0)
+            , m_slots_per_bucket(0)
+            , m_num_buckets(0)
+            , m_size(0) {}
+
+        template <typename T, typename Adaptor>
+        builder(std::vector<T> const& ngrams, compact_vector const& values,
+                Adaptor adaptor, uint64_t key_width = KeyBits)
+            : m_key_width(key_width), m_width(values.width()), m_size(0) {
+            assert(ngrams.size() == values.size());
+            if (key_width == 0 or key_width > 64) {
+                std::cerr << "Error: key width must be > 0 and <= 64."
+                          << std::endl;
+                std::abort();
+            }
+            if (key_width + m_width > bucket_bits) {
+                std::cerr << "Error: slots do not fit a bucket." << std::endl;
+                std::abort();
+            }
+
+            m_size = ngrams.size();
+            m_slots_per_bucket = bucket_bits / (m_key_width + m_width);
+            uint64_t num_buckets = std::max<uint64_t>(
+                1, std::ceil(m_size / (m_slots_per_bucket * max_load)));
+
+            std::vector<item> items;
+            items.reserve(m_size);
+            std::mt19937_64 rng(37);  // deterministic seed
+            for (size_t trial = 0;; ++trial) {
+                essentials::logger("Filling cuckoo table: trial " +
+                                   std::to_string(trial));
+                m_hasher = BaseHasher::generate(rng);
+                m_num_buckets = num_buckets;
+                items.clear();
+                auto it = values.begin();
+                for (auto const& gram : ngrams) {
+                    auto hashes = m_hasher(adaptor(gram));
+                    items.push_back({std::get<0>(hashes), first(hashes),
+                                     second(hashes), fingerprint(hashes),
+                                     *it});
+                    ++it;
+                }
+                if (!fill_stash(items)) continue;
+                if (fill(items, rng)) break;
+                essentials::logger("Too many kicks: growing the table");
+                num_buckets = std::ceil(num_buckets * 1.1);
+            }
+        }
+
+        void build(cuckoo_table& table) {
+            table.m_key_width = m_key_width;
+            table.m_width = m_width;
+            table.m_slot_bits = m_key_width + m_width;
+            table.m_slots_per_bucket = m_slots_per_bucket;
+            table.m_num_buckets = m_num_buckets;
+            table.m_size = m_size;
+            table.m_hasher.swap(m_hasher);
+            table.m_buckets.swap(m_buckets);
+            table.m_stash.swap(m_stash);
+            builder().swap(*this);
+        }
+
+        void swap(builder& other) {
+            std::swap(m_key_width, other.m_key_width);
+            std::swap(m_width, other.m_width);
+            std::swap(m_slots_per_bucket, other.m_slots_per_bucket);
+            std::swap(m_num_buckets, other.m_num_buckets);
+            std::swap(m_size, other.m_size);
+            m_hasher.swap(other.m_hasher);
+            m_buckets.swap(other.m_buckets);
+            m_stash.swap(other.m_stash);
+        }
+
+    private:
+        uint64_t m_key_width;
+        uint64_t m_width;
+        uint64_t m_slots_per_bucket;
+        uint64_t m_num_buckets;
+        uint64_t m_size;
+        BaseHasher m_hasher;
+        std::vector<bucket> m_buckets;
+        std::vector<uint64_pair> m_stash;
+
+        static constexpr double max_load = 0.9;
+        static constexpr uint64_t max_kicks = 500;
+        static constexpr uint64_t empty = uint64_t(-1);
+
+        struct item {
+            uint64_t hash;
+            uint64_t first, second;
+            uint64_t fingerprint;
+            uint64_t value;
+        };
+
+        inline uint64_t first(hash_triple_t hashes) const {
+            return range(std::get<0>(hashes), m_num_buckets);
+        }
+
+        inline uint64_t second(hash_triple_t hashes) const {
+            return range(std::get<1>(hashes), m_num_buckets);
+        }
+
+        inline uint64_t fingerprint(hash_triple_t hashes) const {
+            return cuckoo_table::fingerprint(std::get<2>(hashes),
+                                             m_key_width);
+        }
+
+        // move to the stash the items having the same fingerprint
+        // of another item sharing one of their buckets
+        bool fill_stash(std::vector<item>& items) {
+            // (fingerprint, bucket) -> item
+            std::vector<uint64_triplet> keys;
+            keys.reserve(2 * items.size());
+            for (uint64_t i = 0; i != items.size(); ++i) {
+                auto const& x = items[i];
+                keys.emplace_back(x.fingerprint, x.first, i);
+                if (x.second != x.first) {
+                    keys.emplace_back(x.fingerprint, x.second, i);
+                }
+            }
+            std::sort(keys.begin(), keys.end());
+
+            std::vector<bool> stashed(items.size(), false);
+            for (uint64_t i = 1; i < keys.size(); ++i) {
+                using std::get;
+                if (get<0>(keys[i]) == get<0>(keys[i - 1]) and
+                    get<1>(keys[i]) == get<1>(keys[i - 1])) {
+                    stashed[get<2>(keys[i])] = true;
+                    stashed[get<2>(keys[i - 1])] = true;
+                }
+            }
+
+            m_stash.clear();
+            uint64_t j = 0;
+            for (uint64_t i = 0; i != items.size(); ++i) {
+                if (stashed[i]) {
+                    m_stash.emplace_back(items[i].hash, items[i].value);
+                } else {
+                    items[j++] = items[i];
+                }
+            }
+            items.resize(j);
+
+            std::sort(m_stash.begin(), m_stash.end());
+            for (uint64_t i = 1; i < m_stash.size(); ++i) {
+                if (m_stash[i].first == m_stash[i - 1].first) {
+                    essentials::logger("Duplicate hashes: trying a new seed");
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // random walk insertion: an item that finds both its buckets
+        // full kicks out a random item of one of them, that is moved
+        // to its other bucket
+        template <typename Rng>
+        bool fill(std::vector<item> const& items, Rng& rng) {
+            std::vector<uint64_t> slots(m_num_buckets * m_slots_per_bucket,
+                                        empty);
+            std::vector<uint64_t> sizes(m_num_buckets, 0);
+
+            for (uint64_t i = 0; i != items.size(); ++i) {
+                uint64_t x = i;
+                uint64_t from = empty;
+                for (uint64_t kicks = 0;; ++kicks) {
+                    auto const& y = items[x];
+                    uint64_t b = y.first;
+                    if (sizes[b] == m_slots_per_bucket) b = y.second;
+                    if (sizes[b] != m_slots_per_bucket) {
+                        slots[b * m_slots_per_bucket + sizes[b]++] = x;
+                        break;
+                    }
+                    if (kicks == max_kicks) return false;
+                    if (from == y.first) {
+                        b = y.second;
+                    } else if (from == y.second) {
+                        b = y.first;
+                    } else {
+                        b = rng() & 1 ? y.first : y.second;
+                    }
+                    std::swap(x, slots[b * m_slots_per_bucket +
+                                       rng() % m_slots_per_bucket]);
+                    from = b;
+                }
+            }
+
+            m_buckets.resize(m_num_buckets);
+            for (uint64_t b = 0; b != m_num_buckets; ++b) {
+                auto& words = m_buckets[b].words;
+                std::fill(words, words + 8, 0);
+                for (uint64_t s = 0; s != sizes[b]; ++s) {
+                    auto const& x = items[slots[b * m_slots_per_bucket + s]];
+                    uint64_t pos = s * (m_key_width + m_width);
+                    set_bits(words, pos, m_key_width, x.fingerprint);
+                    set_bits(words, pos + m_key_width, m_width, x.value);
+                }
+            }
+            return true;
+        }
+    };
+
+    cuckoo_table()
+        : m_key_width(KeyBits)
+        , m_width(0)
+        , m_slot_bits(0)
+        , m_slots_per_bucket(0)
+        , m_num_buckets(0)
+        , m_size(0) {}
+
+    cuckoo_table(cuckoo_table::builder& in) {
+        in.build(*this);
+        cuckoo_table::builder().swap(in);
+    }
+
+    template <typename T, typename Adaptor>
+    uint64_t lookup(T gram, Adaptor adaptor) const {
+        auto hashes = m_hasher(adaptor(gram));
+        auto const& b1 =
+            m_buckets[range(std::get<0>(hashes), m_num_buckets)];
+        auto const& b2 =
+            m_buckets[range(std::get<1>(hashes), m_num_buckets)];
+        util::prefetch(&b2);
+        if (!m_stash.empty()) {
+            uint64_t value = find_in_stash(std::get<0>(hashes));
+            if (value != global::not_found) return value;
+        }
+        uint64_t fp = fingerprint(std::get<2>(hashes), m_key_width);
+        uint64_t value = find(b1, fp);
+        if (value != global::not_found) return value;
+        return find(b2, fp);
+    }
+
+    size_t size() const {
+        return m_size;
+    }
+
+    uint64_t key_width() const {
+        return m_key_width;
+    }
+
+    // NOTE: an absent key is compared with the fingerprints
+    // of at most two full buckets
+    double false_positive_rate() const {
+        return 2.0 * m_slots_per_bucket / std::pow(2.0, m_key_width);
+    }
+
+    double load_factor() const {
+        return m_num_buckets
+                   ? double(m_size - m_stash.size()) /
+                         (m_num_buckets * m_slots_per_bucket)
+                   : 0.0;
+    }
+
+    size_t data_bytes() const {
+        return essentials::vec_bytes(m_buckets) +
+               essentials::vec_bytes(m_stash);
+    }
+
+    void swap(cuckoo_table& other) {
+        std::swap(m_key_width, other.m_key_width);
+        std::swap(m_width, other.m_width);
+        std::swap(m_slot_bits, other.m_slot_bits);
+        std::swap(m_slots_per_bucket, other.m_slots_per_bucket);
+        std::swap(m_num_buckets, other.m_num_buckets);
+        std::swap(m_size, other.m_size);
+        m_hasher.swap(other.m_hasher);
+        m_buckets.swap(other.m_buckets);
+        m_stash.swap(other.m_stash);
+    }
+
+    void save(std::ostream& os) const {
+        essentials::save_pod(os, m_key_width);
+        essentials::save_pod(os, m_width);
+        essentials::save_pod(os, m_slots_per_bucket);
+        essentials::save_pod(os, m_num_buckets);
+        essentials::save_pod(os, m_size);
+        m_hasher.save(os);
+        essentials::save_vec(os, m_buckets);
+        essentials::save_vec(os, m_stash);
+    }
+
+    void load(std::istream& is) {
+        essentials::load_pod(is, m_key_width);
+        essentials::load_pod(is, m_width);
+        essentials::load_pod(is, m_slots_per_bucket);
+        essentials::load_pod(is, m_num_buckets);
+        essentials::load_pod(is, m_size);
+        m_hasher.load(is);
+        memory::load_vec(is, m_buckets);
+        memory::load_vec(is, m_stash);
+        m_slot_bits = m_key_width + m_width;
+    }
+
+private:
+    uint64_t m_key_width;
+    uint64_t m_width;
+    uint64_t m_slot_bits;
+    uint64_t m_slots_per_bucket;
+    uint64_t m_num_buckets;
+    uint64_t m_size;
+    BaseHasher m_hasher;
+    std::vector<bucket> m_buckets;
+    std::vector<uint64_pair> m_stash;  // sorted (hash, value) pairs
+
+    // map a hash to [0, n) with a multiplication instead of a modulo
+    static inline uint64_t range(uint64_t hash, uint64_t n) {
+        return (__uint128_t(hash) * n) >> 64;
+    }
+
+    static inline uint64_t mask(uint64_t width) {
+        return width == 64 ? uint64_t(-1) : (uint64_t(1) << width) - 1;
+    }
+
+    // NOTE: zero marks an empty slot
+    static inline uint64_t fingerprint(uint64_t hash, uint64_t width) {
+        uint64_t fp = hash & mask(width);
+        return fp ? fp : 1;
+    }
+
+    static inline uint64_t get_bits(uint64_t const* words, uint64_t pos,
+                                    uint64_t width) {
+        uint64_t block = pos >> 6;
+        uint64_t shift = pos & 63;
+        uint64_t bits = words[block] >> shift;
+        if (shift + width > 64) bits |= words[block + 1] << (64 - shift);
+        return bits & mask(width);
+    }
+
+    static inline void set_bits(uint64_t* words, uint64_t pos, uint64_t width,
+                                uint64_t bits) {
+        uint64_t block = pos >> 6;
+        uint64_t shift = pos & 63;
+        bits &= mask(width);
+        words[block] &= ~(mask(width) << shift);
+        words[block] |= bits << shift;
+        if (shift + width > 64) {
+            uint64_t stored = 64 - shift;
+            words[block + 1] &= ~(mask(width) >> stored);
+            words[block + 1] |= bits >> stored;
+        }
+    }
+
+    inline uint64_t find(bucket const& b, uint64_t fp) const {
+        uint64_t pos = 0;
+        for (uint64_t s = 0; s != m_slots_per_bucket; ++s) {
+            uint64_t x = get_bits(b.words, pos, m_key_width);
+            if (x == fp) return get_bits(b.words, pos + m_key_width, m_width);
+            if (x == 0) break;
+            pos += m_slot_bits;
+        }
+        return global::not_found;
+    }
+
+    uint64_t find_in_stash(uint64_t hash) const {
+        auto it = std::lower_bound(
+            m_stash.begin(), m_stash.end(), hash,
+            [](uint64_pair const& p, uint64_t h) { return p.first < h; });
+        if (it != m_stash.end() and it->first == hash) return it->second;
+        return global::not_found;
+    }
+};
+
+}  // namespace tongrams
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+#include <thread>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "utils/util.hpp"
+
+namespace tongrams {
+namespace memory {
+
+// NOTE:
+// how the buffers of the data structures are allocated when loaded,
+// set before calling util::load:
+//  - huge_pages: back them with (transparent) 2 MB pages, so that
+//    random accesses to large buffers miss the TLB less often;
+//  - prefault_threads: if > 0, the pages are faulted in by that many
+//    threads before the buffer is read, instead of by the reader;
+//  - lock: lock them in memory, so that they are never swapped out;
+//  - load_threads: if > 1, the sections of the data structures (e.g.,
+//    the arrays of the orders of a trie) are loaded in parallel by
+//    that many threads (see load_sections below).
+struct load_policy {
+    load_policy()
+        : huge_pages(false)
+        , prefault_threads(0)
+        , lock(false)
+        , load_threads(1) {}
+
+    bool huge_pages;
+    uint64_t prefault_threads;
+    bool lock;
+    uint64_t load_threads;
+};
+
+inline load_policy policy;
+
+// when set, load_vec skips the buffers instead of reading them
+inline thread_local bool skipping = false;
+
+static const uint64_t huge_page_size = uint64_t(1) << 21;
+
+// touch a byte per page of [begin, end), split among num_threads threads
+inline void prefault(uint8_t* begin, uint8_t* end, uint64_t num_threads) {
+    static const uint64_t page_size = sysconf(_SC_PAGESIZE);
+    uint64_t pages = (end - begin + page_size - 1) / page_size;
+    uint64_t pages_per_thread = (pages + num_threads - 1) / num_threads;
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads);
+    for (uint64_t t = 0; t != num_threads; ++t) {
+        uint64_t first = t * pages_per_thread;
+        uint64_t last = std::min(pages, first + pages_per_thread);
+        if (first >= last) break;
+        threads.emplace_back([=]() {
+            for (uint64_t p = first; p != last; ++p) {
+                *(volatile uint8_t*)(begin + p * page_size) = 0;
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+}
+
+// same as essentials::load_vec, but the buffer is allocated according
+// to the policy before it is written to
+template <typename T>
+void load_vec(std::istream& is, std::vector<T>& vec) {
+    size_t n;
+    essentials::load_pod(is, n);
+    std::vector<T>().swap(vec);
+    if (skipping) {
+        is.seekg(n * sizeof(T), std::ios::cur);
+        return;
+    }
+    // NOTE: reserve() allocates without touching the memory,
+    // so the advice applies to all the pages of the buffer
+    vec.reserve(n);
+    uint8_t* begin = reinterpret_cast<uint8_t*>(vec.data());
+    uint8_t* end = begin + n * sizeof(T);
+    if (policy.huge_pages and n * sizeof(T) >= huge_page_size) {
+        // only the huge pages entirely within the buffer
+        uint64_t mask = huge_page_size - 1;
+        uint8_t* first = (uint8_t*)((uintptr_t(begin) + mask) & ~mask);
+        uint8_t* last = (uint8_t*)(uintptr_t(end) & ~mask);
+        if (first < last and madvise(first, last - first, MADV_HUGEPAGE)) {
+            static bool warned = false;
+            if (!warned) {
+                std::cerr << "Warning: huge pages are not available."
+                          << std::endl;
+                warned = true;
+            }
+        }
+    }
+    if (policy.prefault_threads and n * sizeof(T) >= huge_page_size) {
+        prefault(begin, end, policy.prefault_threads);
+    }
+    vec.resize(n);
+    is.read(reinterpret_cast<char*>(vec.data()),
+            (std::streamsize)(sizeof(T) * n));
+    if (policy.lock and n and mlock(begin, end - begin)) {
+        static bool warned = false;
+        if (!warned) {
+            std::cerr << "Warning: memory cannot be locked "
+                         "(see ulimit -l)."
+                      << std::endl;
+            warned = true;
+        }
+    }
+}
+
+// NOTE:
+// load the sections [begin, end) of a data structure from is, the i-th
+// one with load(is, section, i). With policy.load_threads > 1, and while
+// util::load reads a file, a first pass finds the offsets of the sections
+// by skipping their buffers; then they are loaded in parallel, largest
+// (i.e., last) first, each from its own stream over the file.
+template <typename Iterator, typename Load>
+void load_sections(std::istream& is, Iterator begin, Iterator end,
+                   Load load) {
+    uint64_t n = end - begin;
+    if (policy.load_threads <= 1 or n <= 1 or !util::loading_file) {
+        for (uint64_t i = 0; i != n; ++i) load(is, begin[i], i);
+        return;
+    }
+
+    std::vector<std::streamoff> offsets(n);
+    skipping = true;
+    for (uint64_t i = 0; i != n; ++i) {
+        offsets[i] = is.tellg();
+        typename std::iterator_traits<Iterator>::value_type skipped;
+        load(is, skipped, i);
+    }
+    skipping = false;
+
+    std::string filename(util::loading_file);
+    std::atomic<uint64_t> next(0);
+    std::vector<std::thread> threads;
+    uint64_t num_threads = std::min(policy.load_threads, n);
+    threads.reserve(num_threads);
+    for (uint64_t t = 0; t != num_threads; ++t) {
+        threads.emplace_back([&]() {
+            std::ifstream in(filename, std::ios::binary);
+            for (uint64_t k = next++; k < n; k = next++) {
+                uint64_t i = n - 1 - k;
+                in.seekg(offsets[i]);
+                load(in, begin[i], i);
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+}
+
+}  // namespace memory
+}  // namespace tongrams
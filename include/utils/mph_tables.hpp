@@ -2,9 +2,12 @@
 
 #include <vector>
 #include <numeric>
+#include <cmath>
 
 #include "utils/mphf.hpp"
+#include "utils/pthash_mphf.hpp"
 #include "utils/util.hpp"
+#include "utils/wyhash.hpp"
 
 #include "../external/emphf/common.hpp"
 #include "../external/emphf/base_hash.hpp"
@@ -17,32 +20,23 @@
 
 namespace tongrams {
 
-template <typename KeyValueSequence, typename BaseHasher>
+// NOTE: HashFunction is either tongrams::mphf or tongrams::pthash_mphf
+template <typename KeyValueSequence, typename BaseHasher,
+          typename HashFunction = mphf<BaseHasher>>
 struct single_valued_mpht {
-    typedef tongrams::mphf<BaseHasher> hash_function;
+    typedef HashFunction hash_function;
+    static const uint64_t hash_bits = KeyValueSequence::hash_bits;
 
     struct builder {
         builder() {}
 
         template <typename T, typename Adaptor>
         builder(std::vector<T> const& ngrams, compact_vector const& values,
-                Adaptor adaptor)
-            : m_data_builder(values.size(), values.width()) {
+                Adaptor adaptor,
+                uint64_t key_width = KeyValueSequence::hash_bits)
+            : m_data_builder(values.size(), values.width(), key_width) {
             assert(ngrams.size() == values.size());
-            using namespace emphf;
-            size_t n = ngrams.size();
-
-            typedef hypergraph_sorter_scan<uint32_t, mmap_memory_model> hs32_t;
-            typedef hypergraph_sorter_scan<uint64_t, mmap_memory_model> hs64_t;
-            size_t max_nodes =
-                (size_t(std::ceil(double(n) * 1.23)) + 2) / 3 * 3;
-            if (max_nodes >= uint64_t(1) << 32) {
-                hs64_t sorter;
-                hash_function(sorter, n, ngrams, adaptor).swap(m_h);
-            } else {
-                hs32_t sorter;
-                hash_function(sorter, n, ngrams, adaptor).swap(m_h);
-            }
+            hash_function(ngrams.size(), ngrams, adaptor).swap(m_h);
 
             auto it = ngrams.begin();
             for (auto value : values) {
@@ -83,13 +77,21 @@ struct single_valued_mpht {
         uint64_t key = m_h.mix_hashes(hashes);
         uint64_t pos = m_h.lookup(hashes);
         auto const& p = m_data[pos];
-        return p.first == key ? p.second : global::not_found;
+        return p.first == m_data.key(key) ? p.second : global::not_found;
     }
 
     size_t size() const {
         return m_h.size();
     }
 
+    uint64_t key_width() const {
+        return m_data.key_width();
+    }
+
+    double false_positive_rate() const {
+        return m_data.false_positive_rate();
+    }
+
     hash_function const& h() const {
         return m_h;
     }
@@ -126,43 +128,47 @@ typedef single_valued_mpht<hash_compact_vector<uint64_t>,
                            emphf::jenkins64_hasher>
     single_valued_mpht64;
 
-template <typename BaseHasher>
+typedef single_valued_mpht<hash_compact_vector<uint64_t>, wyhash64_hasher>
+    single_valued_wyhash_mpht64;
+
+typedef single_valued_mpht<hash_compact_vector<uint64_t>, wyhash64_hasher,
+                           pthash_mphf<wyhash64_hasher>>
+    single_valued_pthash_mpht64;
+
+template <typename BaseHasher, typename HashFunction = mphf<BaseHasher>>
 struct double_valued_mpht {
-    typedef tongrams::mphf<BaseHasher> hash_function;
+    typedef HashFunction hash_function;
 
-    double_valued_mpht() {}
+    double_valued_mpht() : m_key_width(64) {}
 
     template <typename T, typename Adaptor>
     double_valued_mpht(std::vector<T> const& ngrams, compact_vector const& keys,
                        compact_vector const& values1,
-                       compact_vector const& values2, Adaptor adaptor) {
-        build(ngrams, keys, values1, values2, adaptor);
+                       compact_vector const& values2, Adaptor adaptor,
+                       uint64_t key_width = 64) {
+        build(ngrams, keys, values1, values2, adaptor, key_width);
     }
 
+    // NOTE: key_width is the number of bits of the default hash keys
+    // to keep; it is ignored if keys are provided by client
     template <typename T, typename Adaptor>
     void build(std::vector<T> const& ngrams, compact_vector const& keys,
                compact_vector const& values1, compact_vector const& values2,
-               Adaptor adaptor) {
+               Adaptor adaptor, uint64_t key_width = 64) {
         assert(ngrams.size() == values1.size());
         assert(ngrams.size() == values2.size());
 
-        using namespace emphf;
-        size_t n = ngrams.size();
-
-        typedef hypergraph_sorter_scan<uint32_t, mmap_memory_model> hs32_t;
-        typedef hypergraph_sorter_scan<uint64_t, mmap_memory_model> hs64_t;
-        size_t max_nodes = (size_t(std::ceil(double(n) * 1.23)) + 2) / 3 * 3;
-        if (max_nodes >= uint64_t(1) << 32) {
-            hs64_t sorter;
-            hash_function(sorter, n, ngrams, adaptor).swap(m_h);
-        } else {
-            hs32_t sorter;
-            hash_function(sorter, n, ngrams, adaptor).swap(m_h);
+        if (key_width > 64) {
+            std::cerr << "Error: key width must be <= 64." << std::endl;
+            std::abort();
         }
+        m_key_width = keys.size() ? keys.width() : key_width;
+
+        size_t n = ngrams.size();
+        hash_function(n, ngrams, adaptor).swap(m_h);
 
         compact_triplets_vector::builder data_builder(
-            n, keys.size() ? keys.width() : 64, values1.width(),
-            values2.width());
+            n, m_key_width, values1.width(), values2.width());
         auto it_keys = keys.begin();
         auto it_values1 = values1.begin();
         auto it_values2 = values2.begin();
@@ -171,7 +177,8 @@ struct double_valued_mpht {
             // NOTE:
             // use 64-bit hashes as keys if not provided by client
             // trie_prob_lm uses default 64-bit hashes
-            uint64_t key = keys.size() ? *it_keys : m_h.mix_hashes(hashes);
+            uint64_t key =
+                keys.size() ? *it_keys : this->key(m_h.mix_hashes(hashes));
             uint64_t pos = m_h.lookup(hashes);
             uint64_t value = *it_values2;
             compact_triplets_vector::value_type triple(key, *it_values1, value);
@@ -191,7 +198,7 @@ struct double_valued_mpht {
         uint64_t pos = m_h.lookup(hashes);
         auto const& triple = m_data[pos];
         uint64_pair values;
-        if (std::get<0>(triple) == key) {
+        if (std::get<0>(triple) == this->key(key)) {
             values.first = std::get<1>(triple);
             values.second = std::get<2>(triple);
         } else {
@@ -227,14 +234,22 @@ struct double_valued_mpht {
         uint64_t key = m_h.mix_hashes(hashes);
         uint64_t pos = m_h.lookup(hashes);
         auto const& triple = m_data[pos];
-        return std::get<0>(triple) == key ? std::get<1>(triple)
-                                          : global::not_found;
+        return std::get<0>(triple) == this->key(key) ? std::get<1>(triple)
+                                                     : global::not_found;
     }
 
     size_t size() const {
         return m_h.size();
     }
 
+    uint64_t key_width() const {
+        return m_key_width;
+    }
+
+    double false_positive_rate() const {
+        return std::pow(2.0, -double(m_key_width));
+    }
+
     hash_function const& h() const {
         return m_h;
     }
@@ -244,33 +259,47 @@ struct double_valued_mpht {
     }
 
     void swap(double_valued_mpht& other) {
+        std::swap(m_key_width, other.m_key_width);
         m_h.swap(other.m_h);
         m_data.swap(other.m_data);
     }
 
     void save(std::ostream& os) const {
+        essentials::save_pod(os, m_key_width);
         m_h.save(os);
         m_data.save(os);
     }
 
     void load(std::istream& is) {
+        essentials::load_pod(is, m_key_width);
         m_h.load(is);
         m_data.load(is);
     }
 
 private:
+    uint64_t m_key_width;
     hash_function m_h;
     compact_triplets_vector m_data;
+
+    inline uint64_t key(uint64_t hash) const {
+        return m_key_width == 64
+                   ? hash
+                   : hash & ((uint64_t(1) << m_key_width) - 1);
+    }
 };
 
 typedef double_valued_mpht<emphf::jenkins32_hasher> double_valued_mpht32;
 typedef double_valued_mpht<emphf::jenkins64_hasher> double_valued_mpht64;
+typedef double_valued_mpht<wyhash64_hasher> double_valued_wyhash_mpht64;
+typedef double_valued_mpht<wyhash64_hasher, pthash_mphf<wyhash64_hasher>>
+    double_valued_pthash_mpht64;
 
 // NOTE: used by sequences/fast_ef_sequence.hpp
 template <typename UintValueType1, typename UintValueType2,
-          typename BaseHasher = emphf::jenkins64_hasher>
+          typename BaseHasher = emphf::jenkins64_hasher,
+          typename HashFunction = mphf<BaseHasher>>
 struct uint_mpht {
-    typedef tongrams::mphf<BaseHasher> hash_function;
+    typedef HashFunction hash_function;
 
     uint_mpht() {}
 
@@ -283,19 +312,7 @@ struct uint_mpht {
     template <typename Adaptor>
     void build(std::vector<UintValueType1> const& from,
                std::vector<UintValueType2> const& to, Adaptor adaptor) {
-        using namespace emphf;
-        size_t n = from.size();
-
-        typedef hypergraph_sorter_scan<uint32_t, mmap_memory_model> hs32_t;
-        typedef hypergraph_sorter_scan<uint64_t, mmap_memory_model> hs64_t;
-        size_t max_nodes = (size_t(std::ceil(double(n) * 1.23)) + 2) / 3 * 3;
-        if (max_nodes >= uint64_t(1) << 32) {
-            hs64_t sorter;
-            hash_function(sorter, n, from, adaptor).swap(m_h);
-        } else {
-            hs32_t sorter;
-            hash_function(sorter, n, from, adaptor).swap(m_h);
-        }
+        hash_function(from.size(), from, adaptor).swap(m_h);
 
         auto it = from.begin();
         compact_vector::builder cvb(to.size(), util::ceil_log2(to.back() + 1));
@@ -6,6 +6,8 @@
 #include "../external/emphf/bitpair_vector.hpp"
 #include "../external/emphf/ranked_bitpair_vector.hpp"
 #include "../external/emphf/perfutils.hpp"
+#include "../external/emphf/mmap_memory_model.hpp"
+#include "../external/emphf/hypergraph_sorter_scan.hpp"
 
 namespace tongrams {
 
@@ -15,7 +17,7 @@ struct mphf {
     typedef typename BaseHasher::hash_t hash_t;
     typedef typename BaseHasher::hash_triple_t hash_triple_t;
 
-    mphf() {}
+    mphf() : m_n(0), m_hash_domain(0) {}
 
     template <typename HypergraphSorter, typename Range, typename Adaptor>
     mphf(HypergraphSorter& sorter, size_t n, Range const& input_range,
@@ -69,6 +71,23 @@ struct mphf {
         m_bv.build(std::move(bv));
     }
 
+    // use 64-bit nodes only if needed
+    template <typename Range, typename Adaptor>
+    mphf(size_t n, Range const& input_range, Adaptor adaptor)
+        : m_n(0), m_hash_domain(0) {
+        using namespace emphf;
+        typedef hypergraph_sorter_scan<uint32_t, mmap_memory_model> hs32_t;
+        typedef hypergraph_sorter_scan<uint64_t, mmap_memory_model> hs64_t;
+        size_t max_nodes = (size_t(std::ceil(double(n) * 1.23)) + 2) / 3 * 3;
+        if (max_nodes >= uint64_t(1) << 32) {
+            hs64_t sorter;
+            mphf(sorter, n, input_range, adaptor).swap(*this);
+        } else {
+            hs32_t sorter;
+            mphf(sorter, n, input_range, adaptor).swap(*this);
+        }
+    }
+
     uint64_t size() const {
         return m_n;
     }
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cctype>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "utils/util.hpp"
+
+namespace tongrams {
+namespace numa {
+
+// NOTE:
+// the NUMA topology is read from sysfs and the memory policies are set
+// with raw system calls, so that no library is required: on a machine
+// with a single node (or without sysfs) everything runs on node 0.
+
+// parse a list of ranges as "0-3,8-11"
+inline std::vector<uint64_t> parse_list(std::string const& list) {
+    std::vector<uint64_t> values;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos) end = list.size();
+        std::string range = list.substr(pos, end - pos);
+        size_t dash = range.find('-');
+        if (!range.empty() and std::isdigit(range.front())) {
+            uint64_t first = std::stoull(range.substr(0, dash));
+            uint64_t last = dash == std::string::npos
+                                ? first
+                                : std::stoull(range.substr(dash + 1));
+            for (uint64_t v = first; v <= last; ++v) values.push_back(v);
+        }
+        pos = end + 1;
+    }
+    return values;
+}
+
+inline std::vector<uint64_t> read_list(std::string const& filename) {
+    std::ifstream in(filename);
+    std::string list;
+    std::getline(in, list);
+    return parse_list(list);
+}
+
+// the online nodes
+inline std::vector<uint64_t> nodes() {
+    auto n = read_list("/sys/devices/system/node/online");
+    if (n.empty()) n.push_back(0);
+    return n;
+}
+
+inline std::vector<uint64_t> cpus(uint64_t node) {
+    return read_list("/sys/devices/system/node/node" + std::to_string(node) +
+                     "/cpulist");
+}
+
+// pin the calling thread to the CPUs of node, so that
+// the memory it touches first is allocated on node
+inline bool run_on_node(uint64_t node) {
+    auto node_cpus = cpus(node);
+    if (node_cpus.empty()) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto cpu : node_cpus) CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+// the memory allocated by the calling thread from now on is
+// interleaved among all the nodes (interleaved = true), or
+// allocated according to the default policy (interleaved = false)
+inline bool interleave_memory(bool interleaved) {
+    static const int mpol_default = 0;
+    static const int mpol_interleave = 3;
+    static const uint64_t max_nodes = 1024;
+    uint64_t mask[max_nodes / 64] = {0};
+    for (auto node : nodes()) {
+        if (node < max_nodes) mask[node / 64] |= uint64_t(1) << (node % 64);
+    }
+    if (interleaved) {
+        return syscall(SYS_set_mempolicy, mpol_interleave, mask,
+                       max_nodes + 1) == 0;
+    }
+    return syscall(SYS_set_mempolicy, mpol_default, nullptr, 0) == 0;
+}
+
+// run f(i, node) in num_threads threads, the i-th one pinned
+// to the (i mod number of nodes)-th node
+template <typename Function>
+void for_each_thread(uint64_t num_threads, Function f) {
+    auto n = nodes();
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads);
+    for (uint64_t i = 0; i != num_threads; ++i) {
+        uint64_t node = n[i % n.size()];
+        threads.emplace_back([&f, i, node]() {
+            run_on_node(node);
+            f(i, node);
+        });
+    }
+    for (auto& t : threads) t.join();
+}
+
+// NOTE:
+// a copy of a data structure per node, each loaded by a thread running
+// on the node, so that its memory is local to the threads of the node
+template <typename T>
+struct replicas {
+    template <typename... Args>
+    replicas(std::string const& binary_filename, Args... args) : m_bytes(0) {
+        auto n = nodes();
+        m_index.resize(n.back() + 1, 0);
+        m_replicas.resize(n.size());
+        for (uint64_t i = 0; i != n.size(); ++i) m_index[n[i]] = i;
+        for_each_thread(n.size(), [&](uint64_t i, uint64_t) {
+            size_t bytes = util::load(m_replicas[i], binary_filename, args...);
+            if (i == 0) m_bytes = bytes;
+        });
+    }
+
+    T& local(uint64_t node) {
+        return m_replicas[m_index[node]];
+    }
+
+    uint64_t size() const {
+        return m_replicas.size();
+    }
+
+    // bytes of each replica
+    size_t bytes() const {
+        return m_bytes;
+    }
+
+private:
+    size_t m_bytes;
+    std::vector<uint64_t> m_index;
+    std::vector<T> m_replicas;
+};
+
+}  // namespace numa
+}  // namespace tongrams
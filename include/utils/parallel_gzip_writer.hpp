@@ -0,0 +1,105 @@
+#pragma once
+
+#include <thread>
+#include <fstream>
+
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+namespace tongrams {
+
+// NOTE:
+// writes a multi-member gzip file: the input is cut into
+// blocks of block_size bytes, num_threads blocks at a time
+// are compressed in parallel and the resulting members are
+// appended to the file in input order.
+// The output is readable by any gzip decoder, grams_gzparser included.
+struct parallel_gzip_writer {
+    static const uint64_t block_size = 4 * 1024 * 1024;
+
+    parallel_gzip_writer(std::string const& filename, uint64_t num_threads)
+        : m_os(filename.c_str(), std::ios_base::out | std::ios_base::binary |
+                                     std::ios_base::trunc)
+        , m_cur_block(0) {
+        if (!num_threads) {
+            throw std::invalid_argument("number of threads must be > 0");
+        }
+        if (!m_os.good()) {
+            throw std::runtime_error("error in opening file '" + filename +
+                                     "'");
+        }
+        m_blocks.resize(num_threads);
+        m_members.resize(num_threads);
+        for (auto& block : m_blocks) block.reserve(block_size);
+    }
+
+    ~parallel_gzip_writer() {
+        close();
+    }
+
+    void write(char const* data, uint64_t n) {
+        while (n) {
+            auto& block = m_blocks[m_cur_block];
+            uint64_t k = std::min<uint64_t>(n, block_size - block.size());
+            block.append(data, k);
+            data += k;
+            n -= k;
+            if (block.size() == block_size and
+                ++m_cur_block == m_blocks.size()) {
+                flush();
+            }
+        }
+    }
+
+    void put(char c) {
+        write(&c, 1);
+    }
+
+    void close() {
+        if (!m_os.is_open()) return;
+        flush();
+        m_os.close();
+    }
+
+private:
+    std::ofstream m_os;
+    std::vector<std::string> m_blocks;
+    std::vector<std::string> m_members;
+    uint64_t m_cur_block;
+
+    static void compress(std::string const& block, std::string& member) {
+        member.clear();
+        boost::iostreams::filtering_ostream os;
+        os.push(boost::iostreams::gzip_compressor());
+        os.push(boost::iostreams::back_inserter(member));
+        os.write(block.data(), block.size());
+        os.reset();  // write gzip footer
+    }
+
+    void flush() {
+        uint64_t num_blocks = 0;
+        while (num_blocks != m_blocks.size() and
+               !m_blocks[num_blocks].empty()) {
+            ++num_blocks;
+        }
+        if (!num_blocks) return;
+
+        std::vector<std::thread> threads;
+        threads.reserve(num_blocks - 1);
+        for (uint64_t i = 1; i < num_blocks; ++i) {
+            threads.emplace_back(compress, std::cref(m_blocks[i]),
+                                 std::ref(m_members[i]));
+        }
+        compress(m_blocks[0], m_members[0]);
+        for (auto& t : threads) t.join();
+
+        for (uint64_t i = 0; i != num_blocks; ++i) {
+            m_os.write(m_members[i].data(), m_members[i].size());
+            m_blocks[i].clear();
+        }
+        m_cur_block = 0;
+    }
+};
+
+}  // namespace tongrams
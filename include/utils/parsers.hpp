@@ -308,6 +308,47 @@ private:
     uint64_t m_num_lines;
 };
 
+// NOTE:
+// feed the distinct counts of a grams file to a values builder.
+// If the histogram written by sort_grams is found next to the file,
+// the pass over the grams is skipped.
+// The histogram lists the number of distinct counts in its first line,
+// then one 'count \t frequency' line per distinct count.
+template <typename ValuesBuilder>
+void eat_counts(std::string const& grams_filename, grams_gzparser& gp,
+                ValuesBuilder& counts_builder) {
+    std::string filename;
+    util::histogram_filename(grams_filename, filename);
+    std::ifstream is(filename.c_str());
+    if (!is.good()) {
+        for (auto const& l : gp) {
+            counts_builder.eat_value(l.count);
+        }
+        return;
+    }
+
+    essentials::logger("Reading counts histogram from " + filename);
+    std::string line;
+    std::getline(is, line);
+    uint64_t num_distinct_counts = std::stoull(line);
+    uint64_t num_lines = 0;
+    for (uint64_t i = 0; i != num_distinct_counts; ++i) {
+        if (!std::getline(is, line)) {
+            throw std::runtime_error("histogram '" + filename +
+                                     "' is truncated");
+        }
+        auto record = parse_count_line(line);
+        uint64_t count = util::toull(record.gram);
+        counts_builder.eat_value(count, record.count);
+        num_lines += record.count;
+    }
+
+    if (num_lines != gp.num_lines()) {
+        throw std::runtime_error("histogram '" + filename +
+                                 "' does not match the number of grams");
+    }
+}
+
 // NOTE: non-gzipped version
 // struct grams_parser
 // {
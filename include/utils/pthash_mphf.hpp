@@ -0,0 +1,260 @@
+#pragma once
+
+#include <random>
+#include <cmath>
+#include <numeric>
+
+#include "utils/util.hpp"
+#include "utils/wyhash.hpp"
+#include "vectors/compact_vector.hpp"
+
+namespace tongrams {
+
+// NOTE:
+// minimal perfect hash function in the style of
+// "PTHash: Revisiting FCH Minimal Perfect Hashing"
+// by G. E. Pibiri and R. Trani (SIGIR 2021).
+// The keys are distributed into buckets, 60% of them into 30% of the
+// buckets, and every bucket stores a pilot such that the positions
+// (hash(key) ^ hash(pilot)) mod table_size of its keys do not collide
+// with those of the buckets placed before it, in decreasing size order.
+// The table has n / alpha positions: the ones >= n are remapped
+// to the free positions < n.
+// Differently from tongrams::mphf, a lookup reads a single pilot
+// (and, in few cases, a remapped position) and ranks nothing.
+template <typename BaseHasher>
+struct pthash_mphf {
+    typedef typename BaseHasher::hash_t hash_t;
+    typedef typename BaseHasher::hash_triple_t hash_triple_t;
+
+    pthash_mphf()
+        : m_n(0)
+        , m_table_size(0)
+        , m_num_buckets(0)
+        , m_num_dense_buckets(0) {}
+
+    template <typename Range, typename Adaptor>
+    pthash_mphf(size_t n, Range const& input_range, Adaptor adaptor,
+                double c = 6.0, double alpha = 0.98)
+        : m_n(n) {
+        m_table_size = std::max<uint64_t>(m_n, std::ceil(double(m_n) / alpha));
+        m_num_buckets = std::max<uint64_t>(
+            1, std::ceil(c * m_n / std::max(std::log2(m_n), 1.0)));
+        m_num_dense_buckets = std::max<uint64_t>(1, 0.3 * m_num_buckets);
+        if (m_num_dense_buckets == m_num_buckets) ++m_num_buckets;
+
+        std::mt19937_64 rng(37);  // deterministic seed
+        for (size_t trial = 0;; ++trial) {
+            essentials::logger("Searching pilots: trial " +
+                               std::to_string(trial));
+            m_hasher = BaseHasher::generate(rng);
+            if (search(input_range, adaptor)) break;
+        }
+    }
+
+    uint64_t size() const {
+        return m_n;
+    }
+
+    BaseHasher const& base_hasher() const {
+        return m_hasher;
+    }
+
+    template <typename T, typename Adaptor>
+    inline hash_triple_t hashes(T val, Adaptor adaptor) const {
+        return m_hasher(adaptor(val));
+    }
+
+    inline uint64_t lookup(hash_triple_t hashes) const {
+        uint64_t pilot = m_pilots[bucket(hashes)];
+        uint64_t p = position(position_hash(hashes), pilot);
+        if (p < m_n) return p;
+        return m_free_slots[p - m_n];
+    }
+
+    template <typename T, typename Adaptor>
+    uint64_t lookup(T val, Adaptor adaptor) const {
+        return lookup(hashes(val, adaptor));
+    }
+
+    // same as tongrams::mphf::mix_hashes
+    inline hash_t mix_hashes(hash_triple_t hashes) const {
+        using std::get;
+        hash_t hash = 17;
+        hash = hash * 31 + get<0>(hashes);
+        hash = hash * 31 + get<1>(hashes);
+        hash = hash * 31 + get<2>(hashes);
+        return hash;
+    }
+
+    size_t bytes() const {
+        return sizeof(m_n) + sizeof(m_table_size) + sizeof(m_num_buckets) +
+               sizeof(m_num_dense_buckets) + sizeof(m_hasher) +
+               m_pilots.bytes() + m_free_slots.bytes();
+    }
+
+    void swap(pthash_mphf& other) {
+        std::swap(m_n, other.m_n);
+        std::swap(m_table_size, other.m_table_size);
+        std::swap(m_num_buckets, other.m_num_buckets);
+        std::swap(m_num_dense_buckets, other.m_num_dense_buckets);
+        m_hasher.swap(other.m_hasher);
+        m_pilots.swap(other.m_pilots);
+        m_free_slots.swap(other.m_free_slots);
+    }
+
+    void save(std::ostream& os) const {
+        essentials::save_pod(os, m_n);
+        essentials::save_pod(os, m_table_size);
+        essentials::save_pod(os, m_num_buckets);
+        essentials::save_pod(os, m_num_dense_buckets);
+        m_hasher.save(os);
+        m_pilots.save(os);
+        m_free_slots.save(os);
+    }
+
+    void load(std::istream& is) {
+        essentials::load_pod(is, m_n);
+        essentials::load_pod(is, m_table_size);
+        essentials::load_pod(is, m_num_buckets);
+        essentials::load_pod(is, m_num_dense_buckets);
+        m_hasher.load(is);
+        m_pilots.load(is);
+        m_free_slots.load(is);
+    }
+
+private:
+    uint64_t m_n;
+    uint64_t m_table_size;
+    uint64_t m_num_buckets;
+    uint64_t m_num_dense_buckets;
+    BaseHasher m_hasher;
+    compact_vector m_pilots;
+    compact_vector m_free_slots;
+
+    static const uint64_t max_pilot = uint64_t(1) << 32;
+
+    // NOTE: 32-bit hashers give 32-bit hashes, so we
+    // combine two of them into a 64-bit hash
+    static inline uint64_t bucket_hash(hash_triple_t hashes) {
+        using std::get;
+        if (sizeof(hash_t) == 8) return get<0>(hashes);
+        return (uint64_t(get<0>(hashes)) << 32) | get<2>(hashes);
+    }
+
+    static inline uint64_t position_hash(hash_triple_t hashes) {
+        using std::get;
+        if (sizeof(hash_t) == 8) return get<1>(hashes);
+        return (uint64_t(get<1>(hashes)) << 32) | get<2>(hashes);
+    }
+
+    inline uint64_t bucket(hash_triple_t hashes) const {
+        static const uint64_t dense_threshold = 0.6 * double(uint64_t(-1));
+        uint64_t h = bucket_hash(hashes);
+        if (h < dense_threshold) return h % m_num_dense_buckets;
+        return m_num_dense_buckets +
+               h % (m_num_buckets - m_num_dense_buckets);
+    }
+
+    // map (key hash ^ pilot hash) to [0, table_size) with
+    // a multiplication instead of a modulo
+    inline uint64_t position(uint64_t hash, uint64_t pilot) const {
+        uint64_t h = hash ^ wy::mix(pilot ^ wy::secret[0], wy::secret[1]);
+        return (__uint128_t(h) * m_table_size) >> 64;
+    }
+
+    template <typename Range, typename Adaptor>
+    bool search(Range const& input_range, Adaptor adaptor) {
+        // (bucket, position hash) pairs
+        std::vector<uint64_pair> keys;
+        keys.reserve(m_n);
+        for (auto const& val : input_range) {
+            auto h = m_hasher(adaptor(val));
+            keys.emplace_back(bucket(h), position_hash(h));
+        }
+        assert(keys.size() == m_n);
+        std::sort(keys.begin(), keys.end());
+
+        std::vector<uint64_t> begins(m_num_buckets + 1, 0);
+        for (uint64_t i = 0; i != keys.size(); ++i) {
+            if (i and keys[i] == keys[i - 1]) {
+                essentials::logger("Duplicate hashes: trying a new seed");
+                return false;
+            }
+            ++begins[keys[i].first + 1];
+        }
+
+        // buckets in decreasing size order
+        uint64_t max_bucket_size = 0;
+        for (uint64_t b = 0; b != m_num_buckets; ++b) {
+            max_bucket_size = std::max(max_bucket_size, begins[b + 1]);
+            begins[b + 1] += begins[b];
+        }
+        std::vector<uint64_t> size_begins(max_bucket_size + 2, 0);
+        for (uint64_t b = 0; b != m_num_buckets; ++b) {
+            uint64_t size = begins[b + 1] - begins[b];
+            ++size_begins[max_bucket_size - size + 1];
+        }
+        std::partial_sum(size_begins.begin(), size_begins.end(),
+                         size_begins.begin());
+        std::vector<uint64_t> buckets_by_size(m_num_buckets);
+        for (uint64_t b = 0; b != m_num_buckets; ++b) {
+            uint64_t size = begins[b + 1] - begins[b];
+            buckets_by_size[size_begins[max_bucket_size - size]++] = b;
+        }
+
+        std::vector<uint64_t> pilots(m_num_buckets, 0);
+        std::vector<bool> taken(m_table_size, false);
+        std::vector<uint64_t> positions;
+        positions.reserve(max_bucket_size);
+        uint64_t largest_pilot = 0;
+        for (auto b : buckets_by_size) {
+            if (begins[b + 1] == begins[b]) break;  // empty buckets
+            uint64_t pilot = 0;
+            for (;; ++pilot) {
+                if (pilot == max_pilot) return false;
+                positions.clear();
+                uint64_t i = begins[b];
+                for (; i != begins[b + 1]; ++i) {
+                    uint64_t p = position(keys[i].second, pilot);
+                    if (taken[p]) break;
+                    positions.push_back(p);
+                }
+                if (i != begins[b + 1]) continue;
+                std::sort(positions.begin(), positions.end());
+                if (std::adjacent_find(positions.begin(), positions.end()) ==
+                    positions.end()) {
+                    break;
+                }
+            }
+            for (auto p : positions) taken[p] = true;
+            pilots[b] = pilot;
+            largest_pilot = std::max(largest_pilot, pilot);
+        }
+
+        compact_vector::builder pilots_cvb(pilots.begin(), m_num_buckets,
+                                           util::ceil_log2(largest_pilot + 1));
+        m_pilots.build(pilots_cvb);
+
+        // the i-th taken position >= n is given the i-th free position < n
+        std::vector<uint64_t> free_slots;
+        free_slots.reserve(m_table_size - m_n);
+        uint64_t next_free = 0;
+        for (uint64_t p = m_n; p != m_table_size; ++p) {
+            if (taken[p]) {
+                while (taken[next_free]) ++next_free;
+                assert(next_free < m_n);
+                free_slots.push_back(next_free++);
+            } else {
+                free_slots.push_back(0);  // never accessed
+            }
+        }
+        compact_vector::builder free_slots_cvb(free_slots.begin(),
+                                               free_slots.size(),
+                                               util::ceil_log2(m_n + 1));
+        m_free_slots.build(free_slots_cvb);
+        return true;
+    }
+};
+
+}  // namespace tongrams
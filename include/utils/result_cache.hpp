@@ -0,0 +1,171 @@
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+#include "utils/util.hpp"
+#include "utils/wyhash.hpp"
+
+namespace tongrams {
+
+// NOTE:
+// direct-mapped cache of the results of a model (e.g., the count of an
+// n-gram), keyed by a 64-bit hash of the query: two queries with the same
+// hash are confused, with probability 2^-64 per pair.
+// It can be shared by several threads without locks: every slot is a
+// seqlock, i.e., its version is odd while the slot is written, so that a
+// reader detects a concurrent write as a change of version and reports a
+// miss, and a writer finding the slot busy drops its result.
+// The hits and misses are counted per thread, in separate cache lines.
+template <typename Value>
+struct result_cache {
+    static_assert(std::is_trivially_copyable<Value>::value,
+                  "cached values must be trivially copyable");
+
+    static const uint64_t value_words = (sizeof(Value) + 7) / 8;
+    static const uint64_t slot_bytes = (2 + value_words) * 8;
+    static_assert(slot_bytes <= 64, "cached values must fit a cache line");
+
+    // slots are aligned so that none of them crosses a cache line
+    static const uint64_t slot_alignment =
+        slot_bytes <= 16 ? 16 : (slot_bytes <= 32 ? 32 : 64);
+
+    static const uint64_t seed = 987654321;
+
+    static inline uint64_t hash(byte_range br) {
+        return wy::hash(br.first, br.second - br.first, seed);
+    }
+
+    // num_slots is rounded up to a power of 2
+    result_cache(uint64_t num_slots) {
+        uint64_t n = uint64_t(1) << util::ceil_log2(std::max<uint64_t>(
+                         num_slots, 1));
+        m_mask = n - 1;
+        m_slots.reset(new slot[n]);
+        clear();
+    }
+
+    // NOTE: empties all the slots, e.g., when the model is loaded again;
+    // it must not be called while other threads use the cache
+    void clear() {
+        for (uint64_t i = 0; i != num_slots(); ++i) {
+            m_slots[i].version.store(0, std::memory_order_relaxed);
+        }
+        clear_counters();
+    }
+
+    bool find(uint64_t key, Value& value) const {
+        slot const& s = m_slots[key & m_mask];
+        uint64_t words[value_words];
+        uint64_t version = s.version.load(std::memory_order_acquire);
+        uint64_t k = s.key.load(std::memory_order_relaxed);
+        for (uint64_t i = 0; i != value_words; ++i) {
+            words[i] = s.words[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // NOTE: version 0 marks an empty slot
+        bool hit = version and !(version & 1) and k == key and
+                   s.version.load(std::memory_order_relaxed) == version;
+        counters& c = local_counters();
+        if (hit) {
+            std::memcpy(&value, words, sizeof(Value));
+            c.hits.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            c.misses.fetch_add(1, std::memory_order_relaxed);
+        }
+        return hit;
+    }
+
+    void insert(uint64_t key, Value const& value) {
+        slot& s = m_slots[key & m_mask];
+        uint64_t version = s.version.load(std::memory_order_relaxed);
+        if ((version & 1) or
+            !s.version.compare_exchange_strong(version, version + 1,
+                                               std::memory_order_acquire)) {
+            return;
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+        uint64_t words[value_words] = {0};
+        std::memcpy(words, &value, sizeof(Value));
+        s.key.store(key, std::memory_order_relaxed);
+        for (uint64_t i = 0; i != value_words; ++i) {
+            s.words[i].store(words[i], std::memory_order_relaxed);
+        }
+        s.version.store(version + 2, std::memory_order_release);
+    }
+
+    uint64_t hits() const {
+        uint64_t n = 0;
+        for (auto const& c : m_counters) {
+            n += c.hits.load(std::memory_order_relaxed);
+        }
+        return n;
+    }
+
+    uint64_t misses() const {
+        uint64_t n = 0;
+        for (auto const& c : m_counters) {
+            n += c.misses.load(std::memory_order_relaxed);
+        }
+        return n;
+    }
+
+    double hit_rate() const {
+        uint64_t h = hits();
+        uint64_t total = h + misses();
+        return total ? double(h) / total : 0.0;
+    }
+
+    void clear_counters() {
+        for (auto& c : m_counters) {
+            c.hits.store(0, std::memory_order_relaxed);
+            c.misses.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t num_slots() const {
+        return m_mask + 1;
+    }
+
+    size_t bytes() const {
+        return num_slots() * sizeof(slot);
+    }
+
+private:
+    struct alignas(slot_alignment) slot {
+        std::atomic<uint64_t> version;
+        std::atomic<uint64_t> key;
+        std::atomic<uint64_t> words[value_words];
+    };
+
+    struct alignas(64) counters {
+        std::atomic<uint64_t> hits;
+        std::atomic<uint64_t> misses;
+    };
+
+    // NOTE: threads are assigned the counters in round-robin order,
+    // so they share them only if more than num_counters
+    static const uint64_t num_counters = 64;
+
+    counters& local_counters() const {
+        static std::atomic<uint64_t> next(0);
+        thread_local uint64_t i = next++ % num_counters;
+        return m_counters[i];
+    }
+
+    uint64_t m_mask;
+    std::unique_ptr<slot[]> m_slots;
+    mutable counters m_counters[num_counters];
+};
+
+// true if Model can be given a result_cache
+template <typename Model, typename = void>
+struct has_result_cache : std::false_type {};
+
+template <typename Model>
+struct has_result_cache<Model, std::void_t<typename Model::cache_type>>
+    : std::true_type {};
+
+}  // namespace tongrams
@@ -6,13 +6,13 @@
 #include "mph_prob_lm.hpp"
 #include "trie_count_lm.hpp"
 #include "trie_prob_lm.hpp"
+#include "vectors/cache_line_sorted_array.hpp"
 #include "../external/essentials/include/essentials.hpp"
 
 namespace tongrams {
 
-template <typename Values, typename KeyRankSequence, typename BaseHasher>
-void mph_count_lm<Values, KeyRankSequence, BaseHasher>::print_stats(
-    size_t bytes) const {
+template <typename Values, typename HashTable, bool IdKeys>
+void mph_count_lm<Values, HashTable, IdKeys>::print_stats(size_t bytes) const {
     essentials::logger("========= MPH_COUNT_LM statistics =========");
     uint64_t num_grams = size();
     std::cout << "order: " << order() << "\n";
@@ -22,6 +22,12 @@ void mph_count_lm<Values, KeyRankSequence, BaseHasher>::print_stats(
     std::cout << "unique values bytes: " << m_distinct_counts.bytes() << "\n";
     uint64_t i = 1;
     size_t data_bytes = m_distinct_counts.bytes();
+    if constexpr (IdKeys) {
+        std::cout << "1-grams ranks bytes (by word id): " << m_unigrams.bytes()
+                  << "\n";
+        data_bytes += m_unigrams.bytes();
+    }
+    uint64_t hash_keys_bits = 0;
     for (auto const& t : m_tables) {
         std::cout << i << "-grams stats:\n";
         std::cout << "\tdistinct frequency counters: "
@@ -29,23 +35,41 @@ void mph_count_lm<Values, KeyRankSequence, BaseHasher>::print_stats(
         size_t x = t.data_bytes();
         std::cout << "\tdata table bytes: " << x << std::endl;
         std::cout << "\t(does NOT include hash function bytes)\n";
+        std::cout << "\tbits per hash key: " << t.key_width() << "\n";
+        std::cout << "\texpected false positive rate: "
+                  << t.false_positive_rate() << std::endl;
         data_bytes += x;
+        hash_keys_bits += t.key_width() * t.size();
+        if (!m_filters.empty()) {
+            std::cout << "\tfilter bytes: " << m_filters[i - 1].bytes()
+                      << " (" << m_filters[i - 1].num_hashes()
+                      << " hashes per gram)" << std::endl;
+        }
         ++i;
     }
 
-    uint64_t hash_key_bytes = KeyRankSequence::hash_bits / 8;
-    std::cout << "hash keys bytes: " << hash_key_bytes * num_grams << " ("
-              << hash_key_bytes * num_grams * 100.0 / bytes << "%)\n"
-              << "\tper gram: " << double(hash_key_bytes) / num_grams
+    uint64_t hash_keys_bytes = (hash_keys_bits + 7) / 8;
+    std::cout << "hash keys bytes: " << hash_keys_bytes << " ("
+              << hash_keys_bytes * 100.0 / bytes << "%)\n"
+              << "\tper gram: " << double(hash_keys_bytes) / num_grams
               << std::endl;
 
-    uint64_t counts_bytes = data_bytes - hash_key_bytes * num_grams;
+    uint64_t counts_bytes = data_bytes - hash_keys_bytes;
     std::cout << "counts bytes: " << counts_bytes << " ("
               << counts_bytes * 100.0 / bytes << "%)\n"
               << "\tper gram: " << double(counts_bytes) / num_grams
               << std::endl;
 
-    uint64_t hash_function_bytes = bytes - data_bytes;
+    uint64_t filters_bytes = 0;
+    if (!m_filters.empty()) {
+        filters_bytes = m_filters.bytes();
+        std::cout << "filters bytes: " << filters_bytes << " ("
+                  << filters_bytes * 100.0 / bytes << "%)\n"
+                  << "\tper gram: " << double(filters_bytes) / num_grams
+                  << std::endl;
+    }
+
+    uint64_t hash_function_bytes = bytes - data_bytes - filters_bytes;
     std::cout << "hash functions bytes: " << hash_function_bytes << " ("
               << hash_function_bytes * 100.0 / bytes << "%)\n"
               << "\tper gram: " << double(hash_function_bytes) / num_grams
@@ -55,9 +79,8 @@ void mph_count_lm<Values, KeyRankSequence, BaseHasher>::print_stats(
               << hash_function_bytes * 8.0 / num_grams << std::endl;
 }
 
-template <typename Values, typename KeyRankSequence, typename BaseHasher>
-void mph_prob_lm<Values, KeyRankSequence, BaseHasher>::print_stats(
-    size_t bytes) const {
+template <typename Values, typename HashTable, bool IdKeys>
+void mph_prob_lm<Values, HashTable, IdKeys>::print_stats(size_t bytes) const {
     essentials::logger("========= MPH_PROB_LM statistics =========");
     uint64_t num_grams = size();
     std::cout << "order: " << order() << "\n";
@@ -69,22 +92,32 @@ void mph_prob_lm<Values, KeyRankSequence, BaseHasher>::print_stats(
               << "\n";
     uint64_t i = 1;
     size_t data_bytes = m_probs_averages.bytes() + m_backoffs_averages.bytes();
+    if constexpr (IdKeys) {
+        std::cout << "1-grams values bytes (by word id): " << m_unigrams.bytes()
+                  << "\n";
+        data_bytes += m_unigrams.bytes();
+    }
+    uint64_t hash_keys_bits = 0;
     for (auto const& t : m_tables) {
         std::cout << i << "-grams stats:\n";
         size_t x = t.data_bytes();
         std::cout << "\tdata table bytes: " << x << std::endl;
         std::cout << "\t(does NOT include hash function bytes)\n";
+        std::cout << "\tbits per hash key: " << t.key_width() << "\n";
+        std::cout << "\texpected false positive rate: "
+                  << t.false_positive_rate() << std::endl;
         data_bytes += x;
+        hash_keys_bits += t.key_width() * t.size();
         ++i;
     }
 
-    uint64_t hash_key_bytes = KeyRankSequence::hash_bits / 8;
-    std::cout << "hash keys bytes: " << hash_key_bytes * num_grams << " ("
-              << hash_key_bytes * num_grams * 100.0 / bytes << "%)\n"
-              << "\tper gram: " << double(hash_key_bytes) / num_grams
+    uint64_t hash_keys_bytes = (hash_keys_bits + 7) / 8;
+    std::cout << "hash keys bytes: " << hash_keys_bytes << " ("
+              << hash_keys_bytes * 100.0 / bytes << "%)\n"
+              << "\tper gram: " << double(hash_keys_bytes) / num_grams
               << std::endl;
 
-    uint64_t ranks_bytes = data_bytes - hash_key_bytes * num_grams;
+    uint64_t ranks_bytes = data_bytes - hash_keys_bytes;
     std::cout << "ranks bytes: " << ranks_bytes << " ("
               << ranks_bytes * 100.0 / bytes << "%)\n"
               << "\tper gram: " << double(ranks_bytes) / num_grams << std::endl;
@@ -299,6 +332,22 @@ void sorted_array<Grams, Ranks, Pointers>::print_stats(
     }
 }
 
+template <typename Ranks, typename Pointers>
+void sorted_array<cache_line_layout, Ranks, Pointers>::print_stats(
+    uint8_t /*order*/, sorted_array const* /*parent*/) const {
+    uint64_t n = size();
+    std::cout << "\tnum grams: " << n << "\n";
+    std::cout << "\tgrams per block: " << m_grams_per_block << "\n";
+    std::cout << "\tnum blocks: " << m_blocks.size() << "\n";
+    std::cout << "\tbits per pointer delta: " << m_pointer_width << "\n";
+    std::cout << "\tbits per gram id: " << m_id_width << "\n";
+    std::cout << "\tbits per rank: " << m_rank_width << "\n";
+    uint64_t used_bits =
+        m_ranks_offset + m_grams_per_block * m_rank_width;
+    std::cout << "\tblock fill: " << used_bits * 100.0 / block_bits << "%"
+              << std::endl;
+}
+
 template <typename Vocabulary, typename Mapper, typename Values, typename Ranks,
           typename Grams, typename Pointers>
 void trie_count_lm<Vocabulary, Mapper, Values, Ranks, Grams,
@@ -329,6 +378,12 @@ void trie_count_lm<Vocabulary, Mapper, Values, Ranks, Grams,
                       << " per gram)" << std::endl;
         }
 
+        if (!m_filters.empty()) {
+            uint64_t f = m_filters[i - 1].bytes();
+            std::cout << "\tfilter: " << f << " (" << double(f) / n
+                      << " per gram)" << std::endl;
+        }
+
         ++i;
         grams_bytes += x;
         counts_ranks_bytes += y;
@@ -9,6 +9,8 @@
 #include <cassert>
 #include <locale>
 #include <string.h>
+#include <algorithm>
+#include <numeric>
 
 #include <xmmintrin.h>
 #if TONGRAMS_USE_POPCNT
@@ -319,11 +321,26 @@ void unknown_type(std::string const& type) {
               << "'" << type << "'" << std::endl;
 }
 
+// NOTE:
+// permutation listing the unigrams by descending count,
+// ties broken by input order: order[id] is the input position
+// of the unigram that is assigned identifier id
+template <typename Records>
+void frequency_order(Records const& unigrams, std::vector<uint64_t>& order) {
+    order.resize(unigrams.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&](uint64_t x, uint64_t y) {
+                         return unigrams[x].count > unigrams[y].count;
+                     });
+}
+
 bool is_empty(std::ifstream& is) {
     return is.peek() == std::ifstream::traits_type::eof();
 }
 
-void write(std::ofstream& os, std::string const& line) {
+template <typename Output>
+void write(Output& os, std::string const& line) {
     os.write(line.data(), line.size() * sizeof(char));
 }
 }  // namespace building_util
@@ -367,6 +384,18 @@ void input_filename(const char* input_dir, uint8_t order,
                "-grams.sorted.gz";
 }
 
+void unsorted_input_filename(const char* input_dir, uint8_t order,
+                             std::string& filename) {
+    filename =
+        std::string(input_dir) + "/" + std::to_string(order) + "-grams.gz";
+}
+
+// NOTE: distinct-count histogram written by sort_grams
+void histogram_filename(std::string const& grams_filename,
+                        std::string& filename) {
+    filename = grams_filename + ".hist";
+}
+
 void check_filename(std::string const& filename) {
     std::ifstream is(filename.c_str());
     if (!is.good()) {
@@ -405,12 +434,39 @@ void save(uint8_t header, T const& data_structure,
     }
     std::ofstream os(output_filename, std::ios::binary);
     essentials::save_pod(os, header);
+    essentials::save_pod(os, version::magic);
+    essentials::save_pod(os, version::version_number);
     data_structure.save(os);
     os.close();
 }
 
-template <typename T>
-size_t load(T& data_structure, std::string const& binary_filename) {
+// read the version following the header of a binary file and
+// throw if the file was not written by this version of the library
+void check_version(std::istream& is) {
+    uint32_t magic = 0;
+    uint8_t number = 0;
+    essentials::load_pod(is, magic);
+    essentials::load_pod(is, number);
+    if (magic != version::magic or number != version::version_number) {
+        std::string written_by =
+            magic == version::magic
+                ? "version " + version::lib_version(number)
+                : "a version older than 1.1";
+        throw std::runtime_error(
+            "Error: binary file written by " + written_by +
+            " of the library, but this is version " + version::lib_version() +
+            ": the data structure must be rebuilt.");
+    }
+}
+
+// the file being read by util::load in the calling thread, if any
+inline thread_local char const* loading_file = nullptr;
+
+// NOTE: args are forwarded to the load() of the data structure,
+// e.g., the max_order of the count models
+template <typename T, typename... Args>
+size_t load(T& data_structure, std::string const& binary_filename,
+            Args... args) {
     std::ifstream is(binary_filename, std::ios::binary);
     if (!is.good()) {
         throw std::runtime_error(
@@ -419,7 +475,10 @@ size_t load(T& data_structure, std::string const& binary_filename) {
     uint8_t header = 0;
     essentials::load_pod(is, header);
     (void)header;  // skip header
-    data_structure.load(is);
+    check_version(is);
+    loading_file = binary_filename.c_str();
+    data_structure.load(is, args...);
+    loading_file = nullptr;
     size_t bytes = (size_t)is.tellg();
     is.close();
     return bytes;
@@ -433,6 +492,7 @@ std::string get_model_type(std::string const& binary_filename) {
     }
     uint8_t header = 0;
     essentials::load_pod(is, header);
+    check_version(is);
     binary_header bin_header;
     static constexpr bool verbose = true;
     auto model_string_type = bin_header.parse(header, verbose);
@@ -500,8 +560,38 @@ inline uint64_t bytes_sum(uint64_t x) {
     return x * ones_step_8 >> 56;
 }
 
+#if TONGRAMS_USE_CPU_DISPATCH
+// NOTE:
+// the instructions of the CPU the binary runs on, detected once at startup:
+// POPCNT and PDEP are used if supported, and the portable code otherwise.
+// Before its initialization (i.e., during static initialization of other
+// translation units) no instruction is assumed to be supported.
+struct cpu_features {
+    cpu_features() {
+        __builtin_cpu_init();
+        popcnt = __builtin_cpu_supports("popcnt");
+        bmi2 = __builtin_cpu_supports("bmi2");
+    }
+
+    bool popcnt;
+    bool bmi2;
+};
+
+inline const cpu_features cpu;
+#endif
+
+// as select64_pdep_tzcnt below, inline assembly does not need the
+// instruction to be enabled at compile time
+inline uint64_t popcnt64(uint64_t x) {
+    asm("popcnt %[x], %[x]" : [ x ] "+r"(x));
+    return x;
+}
+
 inline uint64_t popcount(uint64_t x) {
-#if TONGRAMS_USE_POPCNT
+#if TONGRAMS_USE_CPU_DISPATCH
+    if (cpu.popcnt) return popcnt64(x);
+    return bytes_sum(byte_counts(x));
+#elif TONGRAMS_USE_POPCNT
     return uint64_t(_mm_popcnt_u64(x));
 #else
     return bytes_sum(byte_counts(x));
@@ -521,11 +611,7 @@ inline uint64_t select64_pdep_tzcnt(uint64_t x, const uint64_t k) {
     return i;
 }
 
-inline uint64_t select_in_word(const uint64_t x, const uint64_t k) {
-    assert(k < popcount(x));
-#if TONGRAMS_USE_PDEP
-    return select64_pdep_tzcnt(x, k);
-#else
+inline uint64_t select64_broadword(const uint64_t x, const uint64_t k) {
     uint64_t byte_sums = byte_counts(x) * ones_step_8;
     const uint64_t k_step_8 = k * ones_step_8;
     const uint64_t geq_k_step_8 =
@@ -535,6 +621,17 @@ inline uint64_t select_in_word(const uint64_t x, const uint64_t k) {
         k - (((byte_sums << 8) >> place) & uint64_t(0xFF));
     return place +
            tables::select_in_byte[((x >> place) & 0xFF) | (byte_rank << 8)];
+}
+
+inline uint64_t select_in_word(const uint64_t x, const uint64_t k) {
+    assert(k < popcount(x));
+#if TONGRAMS_USE_CPU_DISPATCH
+    if (cpu.bmi2) return select64_pdep_tzcnt(x, k);
+    return select64_broadword(x, k);
+#elif TONGRAMS_USE_PDEP
+    return select64_pdep_tzcnt(x, k);
+#else
+    return select64_broadword(x, k);
 #endif
 }
 
@@ -13,6 +13,7 @@ enum data_structure_type {
     hash = 0,      // minimal perfect hash (MPH)
     ef_trie = 1,   // Elias-Fano trie
     pef_trie = 2,  // partitioned Elias-Fano trie
+    cl_trie = 3,   // cache-line blocked trie
 };
 
 enum value_type { count = 0, prob_backoff = 1, none = 2 };
@@ -23,6 +24,18 @@ enum ranks_type {
     PSPEF = 2  // prefix-sums + partitioned Elias-Fano
 };
 
+// base hash function of the MPH tables and vocabularies
+enum hasher_type { jenkins = 0, wyhash = 1 };
+
+// minimal perfect hash function of the MPH models
+enum mphf_type { hypergraph = 0, pthash = 1 };
+
+// table of the hash models: minimal perfect hashing or cuckoo hashing
+enum table_type { mph = 0, cuckoo = 1 };
+
+// keys of the hash tables of order > 1: n-gram strings or word ids
+enum key_type { string_keys = 0, id_keys = 1 };
+
 typedef std::pair<uint64_t, uint64_t> uint64_pair;
 
 typedef std::tuple<uint64_t, uint64_t, uint64_t> uint64_triplet;
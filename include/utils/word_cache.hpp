@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+
+#include "utils/util.hpp"
+#include "utils/wyhash.hpp"
+
+namespace tongrams {
+
+// NOTE:
+// small direct-mapped cache of the vocabulary lookups of a single thread
+// (see trie_prob_lm::score()): a word is mapped to its slot by a
+// 64-bit wyhash of its string, which is also compared, so two words with
+// the same hash are confused, with probability 2^-63 per pair.
+// Since a few words make up most of the tokens of a text, most words are
+// found here without evaluating the hash function of the vocabulary.
+// The slots are allocated by the first lookup.
+struct word_cache {
+    static const uint64_t num_slots = 1024;  // 24 KB
+    static const uint64_t seed = 31415926535;
+
+    template <typename Lookup>
+    inline uint64_pair lookup(byte_range word, Lookup vocab_lookup) {
+        if (m_slots.empty()) m_slots.resize(num_slots, {0, {0, 0}});
+        // NOTE: an odd hash, since 0 marks an empty slot
+        uint64_t h = wy::hash(word.first, word.second - word.first, seed) | 1;
+        slot& s = m_slots[(h >> 1) & (num_slots - 1)];
+        if (s.hash != h) {
+            s.hash = h;
+            s.value = vocab_lookup(word);
+        }
+        return s.value;
+    }
+
+    // the slots are allocated again by the next lookup
+    void clear() {
+        m_slots.clear();
+    }
+
+private:
+    struct slot {
+        uint64_t hash;
+        uint64_pair value;
+    };
+
+    std::vector<slot> m_slots;
+};
+
+}  // namespace tongrams
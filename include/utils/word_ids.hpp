@@ -0,0 +1,46 @@
+#pragma once
+
+#include "utils/util.hpp"
+
+namespace tongrams {
+
+// NOTE:
+// the hash models with id keys store the n-grams of order > 1 as tuples
+// of 32-bit word ids, assigned by the vocabulary (the table of order 1):
+// the tuples are hashed as fixed-width strings of 4 * order bytes
+typedef uint32_t word_id;
+
+namespace word_ids {
+
+inline byte_range bytes(word_id const* begin, word_id const* end) {
+    return {reinterpret_cast<uint8_t const*>(begin),
+            reinterpret_cast<uint8_t const*>(end)};
+}
+
+// write the ids of the words of gram into ids and return the
+// order minus 1, or global::not_found if a word is not in vocab
+template <typename Vocabulary>
+inline uint64_t map(byte_range gram, Vocabulary const& vocab, word_id* ids) {
+    identity_adaptor adaptor;
+    uint8_t const* begin = gram.first;
+    uint64_t order = 0;  // order minus 1
+    for (auto pos = gram.first; pos != gram.second; ++pos) {
+        // assume words separated by whitespaces:
+        // a leading whitespace is a word itself
+        if (*pos == ' ' and pos != gram.first) {
+            uint64_t id = vocab.lookup(byte_range(begin, pos), adaptor);
+            if (id == global::not_found or order == global::max_order - 1) {
+                return global::not_found;
+            }
+            ids[order++] = id;
+            begin = pos + 1;
+        }
+    }
+    uint64_t id = vocab.lookup(byte_range(begin, gram.second), adaptor);
+    if (id == global::not_found) return global::not_found;
+    ids[order] = id;
+    return order;
+}
+
+}  // namespace word_ids
+}  // namespace tongrams
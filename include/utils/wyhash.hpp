@@ -0,0 +1,140 @@
+#pragma once
+
+#include <tuple>
+#include <cstring>
+
+#include "utils/util_types.hpp"
+#include "../external/essentials/include/essentials.hpp"
+
+namespace tongrams {
+
+// NOTE:
+// adapted from wyhash (final version 4) by Wang Yi:
+// https://github.com/wangyi-fudan/wyhash.
+// It consumes 8 or 16 bytes per multiplication, thus it is much faster
+// than Jenkins' hash on the short strings of a vocabulary or an n-gram.
+namespace wy {
+
+static const uint64_t secret[4] = {
+    0xa0761d6478bd642full, 0xe7037ed1a0b428dbull, 0x8ebc6af09c88c6e3ull,
+    0x589965cc75374cc3ull};
+
+static inline void mum(uint64_t* a, uint64_t* b) {
+    __uint128_t r = *a;
+    r *= *b;
+    *a = uint64_t(r);
+    *b = uint64_t(r >> 64);
+}
+
+static inline uint64_t mix(uint64_t a, uint64_t b) {
+    mum(&a, &b);
+    return a ^ b;
+}
+
+static inline uint64_t read8(uint8_t const* p) {
+    uint64_t v;
+    std::memcpy(&v, p, 8);
+    return v;
+}
+
+static inline uint64_t read4(uint8_t const* p) {
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+static inline uint64_t read3(uint8_t const* p, size_t k) {
+    return (uint64_t(p[0]) << 16) | (uint64_t(p[k >> 1]) << 8) | p[k - 1];
+}
+
+static inline uint64_t hash(uint8_t const* p, size_t len, uint64_t seed) {
+    seed ^= mix(seed ^ secret[0], secret[1]);
+    uint64_t a, b;
+    if (len <= 16) {
+        if (len >= 4) {
+            a = (read4(p) << 32) | read4(p + ((len >> 3) << 2));
+            b = (read4(p + len - 4) << 32) |
+                read4(p + len - 4 - ((len >> 3) << 2));
+        } else if (len > 0) {
+            a = read3(p, len);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+        if (i > 48) {
+            uint64_t seed1 = seed, seed2 = seed;
+            do {
+                seed = mix(read8(p) ^ secret[1], read8(p + 8) ^ seed);
+                seed1 = mix(read8(p + 16) ^ secret[2], read8(p + 24) ^ seed1);
+                seed2 = mix(read8(p + 32) ^ secret[3], read8(p + 40) ^ seed2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= seed1 ^ seed2;
+        }
+        while (i > 16) {
+            seed = mix(read8(p) ^ secret[1], read8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = read8(p + i - 16);
+        b = read8(p + i - 8);
+    }
+    a ^= secret[1];
+    b ^= seed;
+    mum(&a, &b);
+    return mix(a ^ secret[0] ^ len, b ^ secret[1]);
+}
+
+}  // namespace wy
+
+// NOTE:
+// a drop-in replacement for emphf::jenkins32_hasher and
+// emphf::jenkins64_hasher: the three hashes needed by the MPHF
+// are derived from a single 64-bit wyhash of the string
+template <typename HashType>
+struct wyhash_hasher {
+    typedef HashType hash_t;
+    typedef uint64_t seed_t;
+    typedef std::tuple<hash_t, hash_t, hash_t> hash_triple_t;
+
+    wyhash_hasher() : m_seed(0) {}
+
+    wyhash_hasher(seed_t seed) : m_seed(seed) {}
+
+    template <typename Rng>
+    static wyhash_hasher generate(Rng& rng) {
+        return wyhash_hasher(rng());
+    }
+
+    inline hash_triple_t operator()(byte_range s) const {
+        uint64_t h = wy::hash(s.first, s.second - s.first, m_seed);
+        if (sizeof(hash_t) == 8) {
+            return hash_triple_t(h, wy::mix(h, wy::secret[2]),
+                                 wy::mix(h, wy::secret[3]));
+        }
+        return hash_triple_t(h, h >> 32, wy::mix(h, wy::secret[2]));
+    }
+
+    void swap(wyhash_hasher& other) {
+        std::swap(m_seed, other.m_seed);
+    }
+
+    void save(std::ostream& os) const {
+        essentials::save_pod(os, m_seed);
+    }
+
+    void load(std::istream& is) {
+        essentials::load_pod(is, m_seed);
+    }
+
+private:
+    seed_t m_seed;
+};
+
+typedef wyhash_hasher<uint32_t> wyhash32_hasher;
+typedef wyhash_hasher<uint64_t> wyhash64_hasher;
+
+}  // namespace tongrams
@@ -4,6 +4,7 @@
 #include <cstddef>
 
 #include "../utils/util.hpp"
+#include "../utils/memory.hpp"
 
 namespace tongrams {
 
@@ -64,7 +65,9 @@ private:
 };
 
 struct bit_vector_builder {
-    bit_vector_builder(uint64_t size = 0, bool init = 0) : m_size(size) {
+    bit_vector_builder(uint64_t size = 0, bool init = 0)
+        : m_size(size)
+        , m_cur_word(nullptr) {
         m_bits.resize(essentials::words_for(size), uint64_t(-init));
         if (size) {
             m_cur_word = &m_bits.back();
@@ -249,7 +252,7 @@ struct bit_vector {
         }
         uint64_t block = pos >> 6;
         uint64_t shift = pos & 63;
-        uint64_t mask = -(len == 64) | ((1ULL << len) - 1);
+        uint64_t mask = len == 64 ? uint64_t(-1) : (uint64_t(1) << len) - 1;
         if (shift + len <= 64) {
             return m_bits[block] >> shift & mask;
         } else {
@@ -258,6 +261,22 @@ struct bit_vector {
         }
     }
 
+    // same as get_bits(pos, len) for a length known at compile time,
+    // but without branches: the bits past size() are unspecified
+    template <uint64_t Len>
+    inline uint64_t get_bits(uint64_t pos) const {
+        static_assert(Len > 0 and Len <= 64, "invalid length");
+        assert(pos < size());
+        constexpr uint64_t mask =
+            Len == 64 ? uint64_t(-1) : (uint64_t(1) << Len) - 1;
+        uint64_t block = pos >> 6;
+        uint64_t shift = pos & 63;
+        uint64_t next = block + (block + 1 < m_bits.size());
+        return ((m_bits[block] >> shift) |
+                (m_bits[next] << 1 << (63 - shift))) &
+               mask;
+    }
+
     // fast and unsafe version: it retrieves at least 56 bits
     inline uint64_t get_word56(uint64_t pos) const {
         const char* base_ptr = reinterpret_cast<const char*>(m_bits.data());
@@ -303,7 +322,7 @@ struct bit_vector {
 
     void load(std::istream& is) {
         essentials::load_pod(is, m_size);
-        essentials::load_vec(is, m_bits);
+        memory::load_vec(is, m_bits);
     }
 
     struct unary_iterator {
@@ -0,0 +1,385 @@
+#pragma once
+
+#include "compact_vector.hpp"
+#include "sorted_array.hpp"
+
+namespace tongrams {
+
+// NOTE:
+// tag selecting the cache-line layout of a trie level.
+// The grams of a level are cut into blocks of K consecutive grams
+// and each block is stored in 64 bytes (aligned to a cache line) as
+//
+//   | base pointer | K pointer deltas | K gram ids | K ranks | (unused) |
+//
+// where the base pointer and the deltas, relative to it, are present
+// only if the level has children, so that range(), position()
+// and the rank of a gram can all be resolved within a single cache line.
+// K is chosen per level, as the largest value for which the block fits.
+// The Ranks and Pointers parameters of sorted_array are not used.
+struct cache_line_layout {};
+
+template <typename Ranks, typename Pointers>
+struct sorted_array<cache_line_layout, Ranks, Pointers> {
+    struct alignas(64) block {
+        uint64_t words[8];
+    };
+
+    static constexpr uint64_t block_bits = sizeof(block) * 8;
+    static constexpr uint64_t max_grams_per_block = 512;
+
+    struct builder {
+        builder() : m_size(0) {}
+
+        builder(uint64_t num_grams, uint64_t max_gram_id,
+                uint64_t max_count_rank, uint8_t quantization_bits)
+            : m_size(num_grams)
+            , m_grams(num_grams, util::ceil_log2(max_gram_id + 1))
+            , m_counts_ranks(num_grams, util::ceil_log2(max_count_rank + 1))
+            , m_probs_backoffs_ranks(num_grams, quantization_bits) {}
+
+        void add_gram(uint64_t id) {
+            m_grams.push_back(id);
+        }
+
+        void add_count_rank(uint64_t rank) {
+            m_counts_ranks.push_back(rank);
+        }
+
+        // prob and backoff ranks are stored interleaved
+        void add_prob_backoff_rank(uint64_t rank) {
+            m_probs_backoffs_ranks.push_back(rank);
+        }
+
+        // NOTE: the pointers of a level are only known when the next
+        // level is built, so blocks are written here without pointers
+        // and rewritten by build_pointers()
+        template <typename T>
+        void build(sorted_array& sa, T& /*pointers*/, uint8_t /*order*/,
+                   int value_t) {
+            compact_vector grams(m_grams);
+            compact_vector ranks;
+
+            switch (value_t) {
+                case value_type::count:
+                    ranks.build(m_counts_ranks);
+                    break;
+                case value_type::prob_backoff:
+                    ranks.build(m_probs_backoffs_ranks);
+                    break;
+                case value_type::none:
+                    break;
+                default:
+                    assert(false);
+            }
+
+            sa.build_blocks(grams, ranks, std::vector<uint64_t>());
+            builder().swap(*this);
+        }
+
+        void build_counts_ranks(sorted_array& sa, uint8_t /*order*/) {
+            compact_vector counts_ranks(m_counts_ranks);
+            sa.build_blocks(compact_vector(), counts_ranks,
+                            std::vector<uint64_t>());
+            compact_vector::builder().swap(m_counts_ranks);
+        }
+
+        void build_probs_backoffs_ranks(sorted_array& sa, uint8_t /*order*/) {
+            compact_vector probs_backoffs_ranks(m_probs_backoffs_ranks);
+            sa.build_blocks(compact_vector(), probs_backoffs_ranks,
+                            std::vector<uint64_t>());
+            compact_vector::builder().swap(m_probs_backoffs_ranks);
+        }
+
+        template <typename T>
+        static void build_pointers(sorted_array& sa, T& pointers) {
+            uint64_t n = sa.size();
+            assert(pointers.size() == n + 1);
+            compact_vector::builder grams(n, sa.m_id_width);
+            compact_vector::builder ranks(n, sa.m_rank_width);
+            if (!sa.m_blocks.empty()) {
+                for (uint64_t pos = 0; pos != n; ++pos) {
+                    grams.push_back(sa.gram_id(pos));
+                    ranks.push_back(sa.rank(pos));
+                }
+            }
+            sa.build_blocks(compact_vector(grams), compact_vector(ranks),
+                            pointers);
+        }
+
+        void swap(builder& other) {
+            std::swap(m_size, other.m_size);
+            m_grams.swap(other.m_grams);
+            m_counts_ranks.swap(other.m_counts_ranks);
+            m_probs_backoffs_ranks.swap(other.m_probs_backoffs_ranks);
+        }
+
+    private:
+        uint64_t m_size;
+        compact_vector::builder m_grams;
+        compact_vector::builder m_counts_ranks;
+        compact_vector::builder m_probs_backoffs_ranks;
+    };
+
+    sorted_array()
+        : m_size(0)
+        , m_grams_per_block(0)
+        , m_pointer_width(0)
+        , m_id_width(0)
+        , m_rank_width(0)
+        , m_ids_offset(0)
+        , m_ranks_offset(0) {}
+
+    sorted_array(uint64_t size) : sorted_array() {
+        m_size = size;
+    }
+
+    inline pointer_range range(uint64_t pos) {
+        assert(pos < size());
+        assert(has_pointers());
+        uint64_t b = pos / m_grams_per_block;
+        uint64_t i = pos - b * m_grams_per_block;
+        uint64_t const* words = m_blocks[b].words;
+        uint64_t base = words[0];
+        pointer_range r;
+        r.begin = i ? base + get(words, 64 + (i - 1) * m_pointer_width,
+                                 m_pointer_width)
+                    : base;
+        r.end = base + get(words, 64 + i * m_pointer_width, m_pointer_width);
+        return r;
+    }
+
+    inline uint64_t next(pointer_range& r, uint64_t id) {
+        uint64_t pos = position(r, id);
+        if (pos == global::not_found) {
+            return global::not_found;
+        }
+        r = range(pos);
+        return pos;
+    }
+
+    inline uint64_t count_rank(uint64_t pos) {
+        assert(pos < size());
+        return rank(pos);
+    }
+
+    inline uint64_t prob_backoff_rank(uint64_t pos) const {
+        assert(pos < size());
+        return rank(pos);
+    }
+
+    // NOTE: ids are increasing within a range, so we binary search
+    // until the range spans at most one block and finish with a scan
+    inline uint64_t position(pointer_range r, uint64_t id) {
+        uint64_t lo = r.begin;
+        uint64_t hi = r.end;
+        while (hi - lo > m_grams_per_block) {
+            uint64_t mid = lo + (hi - lo) / 2;
+            if (gram_id(mid) <= id) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        for (; lo < hi; ++lo) {
+            uint64_t x = gram_id(lo);
+            if (x == id) return lo;
+            if (x > id) break;
+        }
+        return global::not_found;
+    }
+
+    sorted_array const* ptrs() const {
+        return this;
+    }
+
+    uint64_t size() const {
+        return m_size;
+    }
+
+    uint64_t grams_per_block() const {
+        return m_grams_per_block;
+    }
+
+    void print_stats(uint8_t order, sorted_array const* parent) const;
+
+    // NOTE: the unused bits of the blocks are accounted as grams' bytes
+    uint64_t grams_bytes() const {
+        return bytes() - counts_ranks_bytes() - pointers_bytes();
+    }
+
+    uint64_t counts_ranks_bytes() const {
+        return m_blocks.size() * m_grams_per_block * m_rank_width / 8;
+    }
+
+    uint64_t probs_backoffs_ranks_bytes() const {
+        return counts_ranks_bytes();
+    }
+
+    uint64_t pointers_bytes() const {
+        return m_blocks.size() * m_ids_offset / 8;
+    }
+
+    uint64_t bytes() const {
+        return essentials::vec_bytes(m_blocks) + 7 * sizeof(uint64_t);
+    }
+
+    void save(std::ostream& os, uint8_t /*order*/, int /*value_t*/) const {
+        essentials::save_pod(os, m_size);
+        essentials::save_pod(os, m_grams_per_block);
+        essentials::save_pod(os, m_pointer_width);
+        essentials::save_pod(os, m_id_width);
+        essentials::save_pod(os, m_rank_width);
+        essentials::save_pod(os, m_ids_offset);
+        essentials::save_pod(os, m_ranks_offset);
+        essentials::save_vec(os, m_blocks);
+    }
+
+    void load(std::istream& is, uint8_t /*order*/, int /*value_t*/) {
+        essentials::load_pod(is, m_size);
+        essentials::load_pod(is, m_grams_per_block);
+        essentials::load_pod(is, m_pointer_width);
+        essentials::load_pod(is, m_id_width);
+        essentials::load_pod(is, m_rank_width);
+        essentials::load_pod(is, m_ids_offset);
+        essentials::load_pod(is, m_ranks_offset);
+        memory::load_vec(is, m_blocks);
+    }
+
+private:
+    uint64_t m_size;
+    uint64_t m_grams_per_block;
+    uint64_t m_pointer_width;
+    uint64_t m_id_width;
+    uint64_t m_rank_width;
+    uint64_t m_ids_offset;    // in bits, within a block
+    uint64_t m_ranks_offset;  // in bits, within a block
+    std::vector<block> m_blocks;
+
+    bool has_pointers() const {
+        return m_ids_offset != 0;
+    }
+
+    static inline uint64_t get(uint64_t const* words, uint64_t offset,
+                               uint64_t width) {
+        uint64_t i = offset >> 6;
+        uint64_t shift = offset & 63;
+        // NOTE: a shift by 64 is undefined, so full words are not shifted
+        uint64_t mask =
+            width == 64 ? uint64_t(-1) : (uint64_t(1) << width) - 1;
+        uint64_t x = words[i] >> shift;
+        if (shift + width > 64) {
+            x |= words[i + 1] << (64 - shift);
+        }
+        return x & mask;
+    }
+
+    static inline void set(uint64_t* words, uint64_t offset, uint64_t width,
+                           uint64_t x) {
+        if (!width) return;
+        uint64_t i = offset >> 6;
+        uint64_t shift = offset & 63;
+        words[i] |= x << shift;
+        if (shift + width > 64) {
+            words[i + 1] |= x >> (64 - shift);
+        }
+    }
+
+    inline uint64_t gram_id(uint64_t pos) const {
+        uint64_t b = pos / m_grams_per_block;
+        uint64_t i = pos - b * m_grams_per_block;
+        return get(m_blocks[b].words, m_ids_offset + i * m_id_width,
+                   m_id_width);
+    }
+
+    inline uint64_t rank(uint64_t pos) const {
+        uint64_t b = pos / m_grams_per_block;
+        uint64_t i = pos - b * m_grams_per_block;
+        return get(m_blocks[b].words, m_ranks_offset + i * m_rank_width,
+                   m_rank_width);
+    }
+
+    static uint64_t max_value(compact_vector const& cv) {
+        uint64_t max = 0;
+        for (auto it = cv.begin(); it != cv.end(); ++it) {
+            uint64_t x = *it;
+            if (x > max) max = x;
+        }
+        return max;
+    }
+
+    // largest difference between the pointers delimiting k consecutive grams
+    template <typename T>
+    uint64_t max_span(T const& pointers, uint64_t k) const {
+        uint64_t max = 0;
+        for (uint64_t pos = 0; pos < m_size; pos += k) {
+            uint64_t span =
+                pointers[std::min<uint64_t>(pos + k, m_size)] - pointers[pos];
+            if (span > max) max = span;
+        }
+        return max;
+    }
+
+    template <typename T>
+    void build_blocks(compact_vector const& grams, compact_vector const& ranks,
+                      T const& pointers) {
+        assert(grams.size() == 0 or grams.size() == m_size);
+        assert(ranks.size() == 0 or ranks.size() == m_size);
+        m_id_width = grams.size() ? util::ceil_log2(max_value(grams) + 1) : 0;
+        m_rank_width = ranks.size() ? util::ceil_log2(max_value(ranks) + 1) : 0;
+        m_pointer_width = 0;
+
+        uint64_t header_bits = pointers.empty() ? 0 : 64;
+        uint64_t k = std::min<uint64_t>(
+            (block_bits - header_bits) /
+                std::max<uint64_t>(m_id_width + m_rank_width, 1),
+            max_grams_per_block);
+        if (!pointers.empty()) {
+            for (; k > 1; --k) {
+                m_pointer_width =
+                    util::ceil_log2(max_span(pointers, k) + 1);
+                if (header_bits +
+                        k * (m_pointer_width + m_id_width + m_rank_width) <=
+                    block_bits) {
+                    break;
+                }
+            }
+            if (k == 1) {
+                m_pointer_width = util::ceil_log2(max_span(pointers, 1) + 1);
+            }
+        }
+
+        m_grams_per_block = k;
+        m_ids_offset = header_bits + k * m_pointer_width;
+        m_ranks_offset = m_ids_offset + k * m_id_width;
+        assert(m_ranks_offset + k * m_rank_width <= block_bits);
+
+        std::vector<block> blocks((m_size + k - 1) / k);
+        for (uint64_t b = 0; b != blocks.size(); ++b) {
+            uint64_t* words = blocks[b].words;
+            std::fill(words, words + 8, uint64_t(0));
+            uint64_t first = b * k;
+            uint64_t last = std::min<uint64_t>(first + k, m_size);
+            if (header_bits) {
+                words[0] = pointers[first];
+            }
+            for (uint64_t pos = first; pos != last; ++pos) {
+                uint64_t i = pos - first;
+                if (header_bits) {
+                    set(words, 64 + i * m_pointer_width, m_pointer_width,
+                        pointers[pos + 1] - pointers[first]);
+                }
+                if (grams.size()) {
+                    set(words, m_ids_offset + i * m_id_width, m_id_width,
+                        grams[pos]);
+                }
+                if (ranks.size()) {
+                    set(words, m_ranks_offset + i * m_rank_width, m_rank_width,
+                        ranks[pos]);
+                }
+            }
+        }
+        m_blocks.swap(blocks);
+    }
+};
+}  // namespace tongrams
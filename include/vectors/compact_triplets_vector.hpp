@@ -28,7 +28,7 @@ struct compact_triplets_vector {
         }
 
         uint64_t mask(uint64_t w) {
-            return -(w == 64) | ((uint64_t(1) << w) - 1);
+            return w == 64 ? uint64_t(-1) : (uint64_t(1) << w) - 1;
         }
 
         void check_width(uint64_t w) {
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <cstring>
+#include <type_traits>
+
 #include "../utils/util.hpp"
+#include "../utils/memory.hpp"
 
 namespace tongrams {
 
@@ -65,7 +69,7 @@ struct compact_vector {
         builder(uint64_t n = 0, uint64_t w = 0)
             : m_size(n)
             , m_width(!w ? w + 1 : w)
-            , m_mask(-(w == 64) | ((1ULL << w) - 1))
+            , m_mask(w == 64 ? uint64_t(-1) : (uint64_t(1) << w) - 1)
             , m_back(0)
             , m_cur_block(0)
             , m_cur_shift(0)
@@ -83,7 +87,7 @@ struct compact_vector {
                 std::cerr << "Error: width must be <= 64." << std::endl;
                 std::terminate();
             }
-            m_mask = -(w == 64) | ((uint64_t(1) << w) - 1);
+            m_mask = w == 64 ? uint64_t(-1) : (uint64_t(1) << w) - 1;
             m_bits.resize(essentials::words_for(m_size * m_width), 0);
         }
 
@@ -221,7 +225,8 @@ struct compact_vector {
     void build(compact_vector::builder& in) {
         m_size = in.size();
         m_width = in.width();
-        m_mask = -(m_width == 64) | ((1ULL << m_width) - 1);
+        m_mask =
+            m_width == 64 ? uint64_t(-1) : (uint64_t(1) << m_width) - 1;
         m_bits.swap(in.bits());
     }
 
@@ -245,10 +250,13 @@ struct compact_vector {
         uint64_t pos = i * m_width;
         uint64_t block = pos >> 6;
         uint64_t shift = pos & 63;
-        return shift + m_width <= 64
-                   ? m_bits[block] >> shift & m_mask
-                   : (m_bits[block] >> shift) |
-                         (m_bits[block + 1] << (64 - shift) & m_mask);
+        // NOTE: no branch on whether the value spans two words:
+        // next is the same word if block is the last one, and then
+        // the bits taken from it are masked off
+        uint64_t next = block + (block + 1 < m_bits.size());
+        return ((m_bits[block] >> shift) |
+                (m_bits[next] << 1 << (63 - shift))) &
+               m_mask;
     }
 
     // it retrieves at least 57 bits
@@ -261,6 +269,38 @@ struct compact_vector {
                m_mask;
     }
 
+    // access for a width known at compile time: the power-of-two widths
+    // are aligned loads, the others take constant masks and no branches
+    template <uint64_t Width>
+    inline uint64_t get(uint64_t i) const {
+        static_assert(Width > 0 and Width <= 64, "invalid width");
+        assert(i < size());
+        assert(Width == m_width);
+        uint8_t const* ptr = reinterpret_cast<uint8_t const*>(m_bits.data());
+        if constexpr (Width == 8 or Width == 16 or Width == 32 or
+                      Width == 64) {
+            typedef typename std::conditional<
+                Width == 8, uint8_t,
+                typename std::conditional<
+                    Width == 16, uint16_t,
+                    typename std::conditional<Width == 32, uint32_t,
+                                              uint64_t>::type>::type>::type
+                word_t;
+            word_t x;
+            std::memcpy(&x, ptr + i * sizeof(word_t), sizeof(word_t));
+            return x;
+        } else {
+            constexpr uint64_t mask = (uint64_t(1) << Width) - 1;
+            uint64_t pos = i * Width;
+            uint64_t block = pos >> 6;
+            uint64_t shift = pos & 63;
+            uint64_t next = block + (block + 1 < m_bits.size());
+            return ((m_bits[block] >> shift) |
+                    (m_bits[next] << 1 << (63 - shift))) &
+                   mask;
+        }
+    }
+
     inline void prefetch(size_t i) const {
         util::prefetch(m_bits.data() + i);
     }
@@ -314,7 +354,7 @@ struct compact_vector {
         essentials::load_pod(is, m_size);
         essentials::load_pod(is, m_width);
         essentials::load_pod(is, m_mask);
-        essentials::load_vec(is, m_bits);
+        memory::load_vec(is, m_bits);
     }
 
 private:
@@ -3,10 +3,17 @@
 #include <iostream>
 #include <vector>
 #include <cassert>
+#include <cmath>
 
 #include "../utils/util.hpp"
+#include "bit_vector.hpp"
 
 namespace tongrams {
+
+// NOTE:
+// each entry is a key_width-bit fingerprint followed by a width-bit value.
+// By default the whole hash is kept as fingerprint; with key_width < hash_bits
+// a missing key is reported as found with probability 2^(-key_width).
 template <typename HashType>
 struct hash_compact_vector {
     typedef HashType hash_t;
@@ -14,15 +21,13 @@ struct hash_compact_vector {
     static const uint64_t hash_bits = sizeof(hash_t) * 8;
 
     struct builder {
-        builder() : m_size(0), m_width(0), m_mask(0) {}
+        builder() : m_size(0), m_key_width(0), m_width(0) {}
 
-        builder(uint64_t n, uint64_t w)
+        builder(uint64_t n, uint64_t w, uint64_t key_width = hash_bits)
             : m_size(n)
+            , m_key_width(key_width)
             , m_width(w)
-            , m_mask(-(w == hash_bits || w == 64) | ((uint64_t(1) << w) - 1))
-            , m_bits(
-                  essentials::words_for<hash_t>(m_size * (hash_bits + m_width)),
-                  0) {
+            , m_bits(m_size * (m_key_width + m_width), 0) {
             if (!m_width) {
                 std::cerr << "Error: value width must be non zero."
                           << std::endl;
@@ -33,54 +38,25 @@ struct hash_compact_vector {
                 std::cerr << "Error: value width must be <= 64." << std::endl;
                 std::abort();
             }
+
+            if (m_key_width > hash_bits) {
+                std::cerr << "Error: key width must be <= " << hash_bits
+                          << "." << std::endl;
+                std::abort();
+            }
         }
 
         void set(uint64_t i, hash_t k, uint64_t v) {
             assert(i < m_size);
-            hash_t pos = i * (hash_bits + m_width);
-            hash_t block = pos / hash_bits;
-            hash_t shift = pos & (hash_bits - 1);
-
-            if (shift) {
-                // writing of key
-                uint64_t hash_key_mask = (hash_t(1) << shift) - 1;
-                m_bits[block] &= hash_key_mask;
-                m_bits[block] |= k << shift;
-                hash_t res_shift = hash_bits - shift;
-                m_bits[block + 1] &= ~hash_key_mask;
-                m_bits[block + 1] |= k >> res_shift;
-
-                // writing of value
-                m_bits[block + 1] &= ~(m_mask << shift);
-                m_bits[block + 1] |= v << shift;
-
-                if (m_width > res_shift) {
-                    m_bits[block + 2] &= ~(m_mask >> res_shift);
-                    m_bits[block + 2] |= v >> res_shift;
-                    if (hash_bits == 32 && m_width > res_shift + 32) {
-                        // NOTE (1): this case is never happening when hash_bits
-                        // == 64
-                        uint64_t res_shift2 = m_width - 32 - res_shift;
-                        m_bits[block + 3] &= ~(m_mask >> res_shift2);
-                        m_bits[block + 3] |= v >> (32 + res_shift);
-                    }
-                }
-            } else {
-                m_bits[block] = k;
-                m_bits[block + 1] &= ~m_mask;
-                m_bits[block + 1] |= v;
-                if (hash_bits == 32 && m_width > 32) {  // see NOTE (1)
-                    uint64_t res_shift = m_width - 32;
-                    m_bits[block + 2] &= ~(m_mask >> res_shift);
-                    m_bits[block + 2] |= v >> 32;
-                }
-            }
+            uint64_t pos = i * (m_key_width + m_width);
+            m_bits.set_bits(pos, k & key_mask(m_key_width), m_key_width);
+            m_bits.set_bits(pos + m_key_width, v, m_width);
         }
 
         void swap(hash_compact_vector::builder& other) {
             std::swap(m_size, other.m_size);
+            std::swap(m_key_width, other.m_key_width);
             std::swap(m_width, other.m_width);
-            std::swap(m_mask, other.m_mask);
             m_bits.swap(other.m_bits);
         }
 
@@ -88,26 +64,26 @@ struct hash_compact_vector {
             return m_size;
         }
 
-        uint64_t width() const {
-            return m_width;
+        uint64_t key_width() const {
+            return m_key_width;
         }
 
-        uint64_t mask() const {
-            return m_mask;
+        uint64_t width() const {
+            return m_width;
         }
 
-        std::vector<hash_t>& bits() {
+        bit_vector_builder& bits() {
             return m_bits;
         }
 
     private:
         uint64_t m_size;
+        uint64_t m_key_width;
         uint64_t m_width;
-        uint64_t m_mask;
-        std::vector<hash_t> m_bits;
+        bit_vector_builder m_bits;
     };
 
-    hash_compact_vector() {}
+    hash_compact_vector() : m_size(0), m_key_width(0), m_width(0) {}
 
     hash_compact_vector(hash_compact_vector::builder& in) {
         build(in);
@@ -115,78 +91,80 @@ struct hash_compact_vector {
 
     void build(hash_compact_vector::builder& in) {
         m_size = in.size();
+        m_key_width = in.key_width();
         m_width = in.width();
-        m_mask = in.mask();
-        m_bits.swap(in.bits());
+        m_bits.build(&in.bits());
         hash_compact_vector::builder().swap(in);
     }
 
-    key_value_pair operator[](uint64_t i) const {
-        hash_t pos = i * (hash_bits + m_width);
-        hash_t block = pos / hash_bits;
-        hash_t shift = pos & (hash_bits - 1);
-
-        hash_t k = 0;
-        uint64_t v = 0;
-        if (shift) {
-            hash_t res_shift = hash_bits - shift;
-            k = (m_bits[block] >> shift) | (m_bits[block + 1] << res_shift);
-            v = (m_bits[block + 1] >> shift) & m_mask;
-
-            if (m_width > res_shift) {
-                uint64_t res_shift2 = m_width - res_shift;
-                v |= (m_bits[block + 2] & ((uint64_t(1) << res_shift2) - 1))
-                     << res_shift;
-                if (hash_bits == 32 &&
-                    m_width > res_shift + 32) {  // see NOTE (1)
-                    uint64_t res_shift2 = m_width - 32 - res_shift;
-                    v |= (m_bits[block + 3] & ((uint64_t(1) << res_shift2) - 1))
-                         << (32 + res_shift);
-                }
-            }
-        } else {
-            k = m_bits[block];
-            v = m_bits[block + 1] & m_mask;
-            if (hash_bits == 32 && m_width > 32) {  // see NOTE (1)
-                uint64_t res_shift = m_width - 32;
-                v |= (m_bits[block + 2] & ((uint64_t(1) << res_shift) - 1))
-                     << 32;
-            }
-        }
+    static hash_t key_mask(uint64_t key_width) {
+        return key_width == hash_bits ? hash_t(-1)
+                                      : (hash_t(1) << key_width) - 1;
+    }
+
+    // the fingerprint stored for hash k
+    inline hash_t key(hash_t k) const {
+        return k & key_mask(m_key_width);
+    }
 
+    inline key_value_pair operator[](uint64_t i) const {
+        assert(i < m_size);
+        uint64_t pos = i * (m_key_width + m_width);
+        hash_t k = m_bits.get_bits<64>(pos) & key_mask(m_key_width);
+        // NOTE: the value width is in [1, 64]
+        uint64_t v = m_bits.get_bits<64>(pos + m_key_width) &
+                     (uint64_t(-1) >> (64 - m_width));
         return {k, v};
     }
 
+    uint64_t size() const {
+        return m_size;
+    }
+
+    uint64_t key_width() const {
+        return m_key_width;
+    }
+
+    uint64_t width() const {
+        return m_width;
+    }
+
+    // probability that a missing key matches the
+    // fingerprint stored in the position it hashes to
+    double false_positive_rate() const {
+        return std::pow(2.0, -double(m_key_width));
+    }
+
     size_t bytes() const {
-        return sizeof(m_size) + sizeof(m_width) + sizeof(m_mask) +
-               m_bits.size() * sizeof(hash_t);
+        return sizeof(m_size) + sizeof(m_key_width) + sizeof(m_width) +
+               m_bits.bytes();
     }
 
     void swap(hash_compact_vector& other) {
         std::swap(m_size, other.m_size);
+        std::swap(m_key_width, other.m_key_width);
         std::swap(m_width, other.m_width);
-        std::swap(m_mask, other.m_mask);
         m_bits.swap(other.m_bits);
     }
 
     void save(std::ostream& os) const {
         essentials::save_pod(os, m_size);
+        essentials::save_pod(os, m_key_width);
         essentials::save_pod(os, m_width);
-        essentials::save_pod(os, m_mask);
-        essentials::save_vec(os, m_bits);
+        m_bits.save(os);
     }
 
     void load(std::istream& is) {
         essentials::load_pod(is, m_size);
+        essentials::load_pod(is, m_key_width);
         essentials::load_pod(is, m_width);
-        essentials::load_pod(is, m_mask);
-        essentials::load_vec(is, m_bits);
+        m_bits.load(is);
     }
 
 private:
     uint64_t m_size;
+    uint64_t m_key_width;
     uint64_t m_width;
-    uint64_t m_mask;
-    std::vector<hash_t> m_bits;
+    bit_vector m_bits;
 };
 }  // namespace tongrams
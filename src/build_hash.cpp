@@ -35,6 +35,39 @@ int main(int argc, char** argv) {
                "'prob_backoff' value "
                "type is specified.",
                "--u", false);
+    parser.add("key_bits",
+               "Bits per hash key of the n-grams of order > 1: from 0 to "
+               "8 * hash_key_bytes. Fewer bits save space at the price of "
+               "a 2^-key_bits false positive rate. Default to "
+               "8 * hash_key_bytes.",
+               "--k", false);
+    parser.add("hasher",
+               "Base hash function of the tables: either 'jenkins' "
+               "(default) or 'wyhash'.",
+               "--hasher", false);
+    parser.add("mphf",
+               "Minimal perfect hash function: either 'hypergraph' "
+               "(default) or 'pthash'. The latter is available with "
+               "'--hasher wyhash' and needs a single memory access per "
+               "lookup.",
+               "--mphf", false);
+    parser.add("table",
+               "Hash table: either 'mph' (default) or 'cuckoo'. The latter "
+               "is available with '--hasher wyhash': it stores no hash "
+               "function and touches at most two cache lines per lookup, "
+               "at the price of more space.",
+               "--table", false);
+    parser.add("ids",
+               "Key the n-grams of order > 1 by the ids of their words "
+               "instead of their strings. Available with '--hasher wyhash' "
+               "and 8-byte hash keys.",
+               "--ids", false, true);
+    parser.add("filter_bits",
+               "Bits per n-gram of a Bloom filter built for each order, "
+               "that rejects most of the n-grams not in the model before "
+               "the model is accessed (e.g., 10 for a 1% false positive "
+               "rate). Valid if 'count' value type is specified.",
+               "--filter_bits", false);
     parser.add("out", "Output filename.", "--out", false);
 
     if (!parser.parse()) return 1;
@@ -66,6 +99,17 @@ int main(int argc, char** argv) {
         return 1;
     }
 
+    uint64_t key_bits = hash_key_bytes * 8;
+    if (parser.parsed("key_bits")) {
+        key_bits = parser.get<uint64_t>("key_bits");
+        if (key_bits > hash_key_bytes * 8) {
+            std::cerr << "Error: invalid number of bits for hash keys.\n"
+                      << "It must be at most " << hash_key_bytes * 8 << "."
+                      << std::endl;
+            return 1;
+        }
+    }
+
     float unk_prob = global::default_unk_prob;
     uint32_t probs_quantization_bits = global::default_probs_quantization_bits;
     uint32_t backoffs_quantization_bits =
@@ -97,6 +141,55 @@ int main(int argc, char** argv) {
         arpa_filename = arpa.c_str();
     }
 
+    if (parser.parsed("hasher")) {
+        auto hasher = parser.get<std::string>("hasher");
+        if (hasher == "jenkins") {
+            bin_header.hasher_t = hasher_type::jenkins;
+        } else if (hasher == "wyhash") {
+            bin_header.hasher_t = hasher_type::wyhash;
+        } else {
+            std::cerr << "Error: invalid hasher.\n"
+                      << "It must be either 'jenkins' or 'wyhash'."
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    if (parser.parsed("mphf")) {
+        auto mphf = parser.get<std::string>("mphf");
+        if (mphf == "hypergraph") {
+            bin_header.mphf_t = mphf_type::hypergraph;
+        } else if (mphf == "pthash") {
+            bin_header.mphf_t = mphf_type::pthash;
+        } else {
+            std::cerr << "Error: invalid mphf.\n"
+                      << "It must be either 'hypergraph' or 'pthash'."
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    if (parser.parsed("table")) {
+        auto table = parser.get<std::string>("table");
+        if (table == "mph") {
+            bin_header.table_t = table_type::mph;
+        } else if (table == "cuckoo") {
+            bin_header.table_t = table_type::cuckoo;
+            if (key_bits == 0) {
+                std::cerr << "Error: cuckoo tables need at least 1 bit "
+                             "per hash key."
+                          << std::endl;
+                return 1;
+            }
+        } else {
+            std::cerr << "Error: invalid table.\n"
+                      << "It must be either 'mph' or 'cuckoo'." << std::endl;
+            return 1;
+        }
+    }
+
+    if (parser.parsed("ids")) bin_header.keys_t = key_type::id_keys;
+
     uint8_t header = bin_header.get();
     auto model_string_type = bin_header.parse(header);
 
@@ -107,6 +200,24 @@ int main(int argc, char** argv) {
         output_filename = out.c_str();
     }
 
+    uint64_t filter_bits = 0;
+    if (parser.parsed("filter_bits")) {
+        filter_bits = parser.get<uint64_t>("filter_bits");
+        if (filter_bits == 0 or
+            filter_bits > blocked_bloom_filter::max_bits_per_key) {
+            std::cerr << "Error: invalid number of filter bits.\n"
+                      << "It must be > 0 and <= "
+                      << blocked_bloom_filter::max_bits_per_key << "."
+                      << std::endl;
+            return 1;
+        }
+        if (bin_header.value_t == value_type::prob_backoff) {
+            std::cerr << "warning: option '--filter_bits' ignored with data "
+                         "type 'prob_backoff' specified."
+                      << std::endl;
+        }
+    }
+
     if (bin_header.value_t == value_type::count and arpa_filename != nullptr) {
         std::cerr << "warning: option '--arpa' ignored with data type 'count' "
                      "specified."
@@ -118,7 +229,7 @@ int main(int argc, char** argv) {
 #define LOOP_BODY(R, DATA, T)                              \
     }                                                      \
     else if (model_string_type == BOOST_PP_STRINGIZE(T)) { \
-        T model(input_dir, order);                         \
+        T model(input_dir, order, key_bits, filter_bits);  \
         util::save(header, model, output_filename);
 
             BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, TONGRAMS_HASH_COUNT_TYPES);
@@ -133,7 +244,8 @@ int main(int argc, char** argv) {
     else if (model_string_type == BOOST_PP_STRINGIZE(T)) { \
         T::builder builder(arpa_filename, order, unk_prob, \
                            probs_quantization_bits,        \
-                           backoffs_quantization_bits);    \
+                           backoffs_quantization_bits,     \
+                           key_bits);                      \
         T model;                                           \
         builder.build(model);                              \
         util::save(header, model, output_filename);
@@ -8,9 +8,9 @@ int main(int argc, char** argv) {
     using namespace tongrams;
     cmd_line_parser::parser parser(argc, argv);
 
-    parser.add(
-        "data_structure_type",
-        "Data structure type. It must be either 'ef_trie' or 'pef_trie'.");
+    parser.add("data_structure_type",
+               "Data structure type. It must be either 'ef_trie', 'pef_trie' "
+               "or 'cl_trie'.");
     parser.add("order", "Language model order. It must be > 0 and <= " +
                             std::to_string(global::max_order) + ".");
     parser.add("value_type",
@@ -45,6 +45,29 @@ int main(int argc, char** argv) {
                "Ranks type. It must be either 'IC', 'PSEF' or 'PSPEF'. Valid "
                "if 'count' value type is specified.",
                "--ranks", false);
+    parser.add("unsorted",
+               "Read the unsorted n-gram counts files 'N-grams.gz' from the "
+               "input directory and sort them while building. Valid if "
+               "'count' value type is specified.",
+               "--unsorted", false, true);
+    parser.add("freq_vocab",
+               "Assign word ids by descending unigram count and sort the "
+               "n-grams accordingly. Valid if '--unsorted' is specified.",
+               "--freq_vocab", false, true);
+    parser.add("tmp_dir",
+               "Temporary directory for sorting. Valid if '--unsorted' is "
+               "specified.",
+               "--tmp", false);
+    parser.add("hasher",
+               "Base hash function of the vocabulary: either 'jenkins' "
+               "(default) or 'wyhash'.",
+               "--hasher", false);
+    parser.add("filter_bits",
+               "Bits per n-gram of a Bloom filter built for each order, "
+               "that rejects most of the n-grams not in the model before "
+               "the model is accessed (e.g., 10 for a 1% false positive "
+               "rate). Valid if 'count' value type is specified.",
+               "--filter_bits", false);
     parser.add("out", "Output filename.", "--out", false);
 
     if (!parser.parse()) return 1;
@@ -62,10 +85,13 @@ int main(int argc, char** argv) {
         bin_header.data_structure_t = data_structure_type::ef_trie;
     } else if (data_structure_type == "pef_trie") {
         bin_header.data_structure_t = data_structure_type::pef_trie;
+    } else if (data_structure_type == "cl_trie") {
+        bin_header.data_structure_t = data_structure_type::cl_trie;
     }
     if (binary_header::is_invalid(bin_header.data_structure_t)) {
         std::cerr << "Error: invalid data structure type.\n";
-        std::cerr << "Either 'ef_trie' or 'pef_trie' must be specified."
+        std::cerr << "Either 'ef_trie', 'pef_trie' or 'cl_trie' must be "
+                     "specified."
                   << std::endl;
         return 1;
     }
@@ -119,6 +145,20 @@ int main(int argc, char** argv) {
         arpa_filename = arpa.c_str();
     }
 
+    if (bin_header.data_structure_t == data_structure_type::cl_trie) {
+        if (remapping_order) {
+            std::cerr << "Error: context remapping is not supported by "
+                         "data structure type 'cl_trie'."
+                      << std::endl;
+            return 1;
+        }
+        if (parser.parsed("ranks")) {
+            std::cerr << "warning: option '--ranks' ignored with data "
+                         "structure type 'cl_trie' specified."
+                      << std::endl;
+        }
+    }
+
     if (parser.parsed("ranks")) {
         auto ranks_type = parser.get<std::string>("ranks");
         if (ranks_type == "IC") {
@@ -130,6 +170,20 @@ int main(int argc, char** argv) {
         }
     }
 
+    if (parser.parsed("hasher")) {
+        auto hasher = parser.get<std::string>("hasher");
+        if (hasher == "jenkins") {
+            bin_header.hasher_t = hasher_type::jenkins;
+        } else if (hasher == "wyhash") {
+            bin_header.hasher_t = hasher_type::wyhash;
+        } else {
+            std::cerr << "Error: invalid hasher.\n"
+                      << "It must be either 'jenkins' or 'wyhash'."
+                      << std::endl;
+            return 1;
+        }
+    }
+
     uint8_t header = bin_header.get();
     auto model_string_type = bin_header.parse(header);
 
@@ -140,20 +194,76 @@ int main(int argc, char** argv) {
         output_filename = out.c_str();
     }
 
+    uint64_t filter_bits = 0;
+    if (parser.parsed("filter_bits")) {
+        filter_bits = parser.get<uint64_t>("filter_bits");
+        if (filter_bits == 0 or
+            filter_bits > blocked_bloom_filter::max_bits_per_key) {
+            std::cerr << "Error: invalid number of filter bits.\n"
+                      << "It must be > 0 and <= "
+                      << blocked_bloom_filter::max_bits_per_key << "."
+                      << std::endl;
+            return 1;
+        }
+        if (bin_header.value_t == value_type::prob_backoff) {
+            std::cerr << "warning: option '--filter_bits' ignored with data "
+                         "type 'prob_backoff' specified."
+                      << std::endl;
+        }
+    }
+
     if (bin_header.value_t == value_type::count and arpa_filename != nullptr) {
         std::cerr << "warning: option '--arpa' ignored with data type 'count' "
                      "specified."
                   << std::endl;
     }
 
+    bool unsorted = parser.parsed("unsorted");
+    bool frequency_order = parser.parsed("freq_vocab");
+    if (frequency_order and !unsorted) {
+        std::cerr << "Error: option '--freq_vocab' requires '--unsorted'.\n"
+                  << "Use 'sort_grams --freq_vocab' to sort the input files "
+                     "instead."
+                  << std::endl;
+        return 1;
+    }
+    if (bin_header.value_t == value_type::prob_backoff and unsorted) {
+        if (frequency_order) {
+            std::cerr << "Error: option '--freq_vocab' is not valid with data "
+                         "type 'prob_backoff'.\n"
+                      << "Use 'sort_arpa --freq_vocab' to sort the ARPA file "
+                         "instead."
+                      << std::endl;
+            return 1;
+        }
+        std::cerr << "warning: option '--unsorted' ignored with data type "
+                     "'prob_backoff' specified."
+                  << std::endl;
+    }
+
+    std::string default_tmp_dir(".");
+    std::string tmp_dir = default_tmp_dir;
+    if (parser.parsed("tmp_dir")) {
+        if (unsorted and bin_header.value_t == value_type::count) {
+            tmp_dir = parser.get<std::string>("tmp_dir");
+            essentials::create_directory(tmp_dir);
+        } else {
+            std::cerr << "warning: option '--tmp' ignored without "
+                         "'--unsorted'."
+                      << std::endl;
+        }
+    }
+
     if (bin_header.value_t == value_type::count) {
         if (false) {
-#define LOOP_BODY(R, DATA, T)                                  \
-    }                                                          \
-    else if (model_string_type == BOOST_PP_STRINGIZE(T)) {     \
-        T::builder builder(input_dir, order, remapping_order); \
-        T model;                                               \
-        builder.build(model);                                  \
+#define LOOP_BODY(R, DATA, T)                                           \
+    }                                                                   \
+    else if (model_string_type == BOOST_PP_STRINGIZE(T)) {              \
+        T::builder builder(input_dir, order, remapping_order, unsorted, \
+                           frequency_order, filter_bits,                \
+                           tmp_dir.c_str());                            \
+        T model;                                                        \
+        builder.build(model);                                           \
         util::save(header, model, output_filename);
 
             BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, TONGRAMS_TRIE_COUNT_TYPES);
@@ -180,5 +290,12 @@ int main(int argc, char** argv) {
         }
     }
 
+    if (tmp_dir != default_tmp_dir) {
+        if (!essentials::remove_directory(tmp_dir)) {
+            std::cerr << "directory '" << tmp_dir << "' not removed"
+                      << std::endl;
+        }
+    }
+
     return 0;
 }
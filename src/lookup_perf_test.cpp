@@ -1,16 +1,46 @@
 #include <iostream>
+#include <chrono>
+#include <memory>
+#include <numeric>
+#include <algorithm>
 
 #include "lm_types.hpp"
 #include "utils/util.hpp"
 #include "utils/pools.hpp"
+#include "utils/numa.hpp"
 #include "../external/essentials/include/essentials.hpp"
 #include "../external/cmd_line_parser/include/parser.hpp"
 
 using namespace tongrams;
 
+template <typename Model>
+void set_cache(Model& model, uint64_t cache_slots) {
+    if (!cache_slots) return;
+    if constexpr (has_result_cache<Model>::value) {
+        model.set_cache(cache_slots);
+    } else {
+        std::cerr << "warning: option '--cache' ignored with this data "
+                     "structure type."
+                  << std::endl;
+    }
+}
+
+template <typename Model>
+void print_cache_stats(Model& model) {
+    if constexpr (has_result_cache<Model>::value) {
+        if (auto cache = model.cache()) {
+            std::cout << "\tCache hit rate: " << cache->hit_rate() << " ("
+                      << cache->num_slots() << " slots, " << cache->bytes()
+                      << " bytes)" << std::endl;
+        }
+    }
+}
+
 template <typename Model>
 void perf_test(std::string const& index_filename,
-               std::string const& query_filename, uint64_t runs) {
+               std::string const& query_filename, uint64_t runs,
+               uint64_t num_threads, std::string const& numa_mode,
+               uint64_t max_order, uint64_t cache_slots) {
     strings_pool sp;
     std::vector<size_t> offsets;
     offsets.push_back(0);
@@ -27,36 +57,112 @@ void perf_test(std::string const& index_filename,
 
     size_t queries = offsets.size() - 1;
     identity_adaptor adaptor;
+    uint8_t const* base_addr = sp.base_addr();
 
-    Model model;
-    essentials::logger("Loading data structure");
-    size_t file_size = util::load(model, index_filename);
-    std::cout << "\tTotal bytes: " << file_size << "\n";
-    std::cout << "\tTotal ngrams: " << model.size() << "\n";
-    std::cout << "\tBytes per gram: " << double(file_size) / model.size()
-              << std::endl;
+    if (!num_threads) {
+        Model model;
+        essentials::logger("Loading data structure");
+        size_t file_size = util::load(model, index_filename, max_order);
+        std::cout << "\tTotal bytes: " << file_size << "\n";
+        std::cout << "\tTotal ngrams: " << model.size() << "\n";
+        std::cout << "\tBytes per gram: " << double(file_size) / model.size()
+                  << std::endl;
+        set_cache(model, cache_slots);
 
-    uint8_t const* base_addr = sp.base_addr();
+        essentials::logger("Performing lookups");
+        essentials::timer_type timer;
+        timer.start();
+        for (size_t run = 0; run != runs; ++run) {
+            for (size_t i = 0; i != queries; ++i) {
+                auto br = sp.get_bytes(base_addr, offsets[i], offsets[i + 1]);
+                uint64_t count = model.lookup(br, adaptor);
+                essentials::do_not_optimize_away(count);
+            }
+        }
+        timer.stop();
+        double elapsed = timer.elapsed();
+        std::cout << "\tMean per run: " << elapsed / (1000000 * runs)
+                  << " [sec]" << std::endl;
+        std::cout << "\tMean per query: " << elapsed / (queries * runs)
+                  << " [musec]" << std::endl;
+        print_cache_stats(model);
+        return;
+    }
 
-    essentials::logger("Performing lookups");
-    std::vector<double> query_times;
-    query_times.reserve(runs - 1);
+    // NOTE: with NUMA replicas every thread queries the replica
+    // of its own node; otherwise all threads share one copy,
+    // interleaved among the nodes with numa_mode == "interleave"
+    essentials::logger("Loading data structure");
+    std::vector<uint64_t> nodes = numa::nodes();
+    std::unique_ptr<numa::replicas<Model>> replicas;
+    Model model;
+    size_t file_size = 0;
+    if (numa_mode == "replicate") {
+        replicas.reset(new numa::replicas<Model>(index_filename, max_order));
+        file_size = replicas->bytes();
+    } else {
+        if (numa_mode == "interleave") numa::interleave_memory(true);
+        file_size = util::load(model, index_filename, max_order);
+        if (numa_mode == "interleave") numa::interleave_memory(false);
+    }
+    // NOTE: a cache per replica, shared by the threads of its node
+    if (replicas) {
+        for (auto node : nodes) set_cache(replicas->local(node), cache_slots);
+    } else {
+        set_cache(model, cache_slots);
+    }
+    std::cout << "\tTotal bytes: " << file_size << "\n";
+    std::cout << "\tNUMA nodes: " << nodes.size() << " (" << numa_mode
+              << ")" << std::endl;
 
+    essentials::logger("Performing lookups with " +
+                       std::to_string(num_threads) + " threads");
+    // latencies in nanoseconds, of all queries of all runs
+    std::vector<std::vector<uint32_t>> latencies(num_threads);
     essentials::timer_type timer;
     timer.start();
-    for (size_t run = 0; run != runs; ++run) {
-        for (size_t i = 0; i != queries; ++i) {
-            auto br = sp.get_bytes(base_addr, offsets[i], offsets[i + 1]);
-            uint64_t count = model.lookup(br, adaptor);
-            essentials::do_not_optimize_away(count);
+    numa::for_each_thread(num_threads, [&](uint64_t t, uint64_t node) {
+        Model& m = replicas ? replicas->local(node) : model;
+        auto& l = latencies[t];
+        l.reserve(queries * runs);
+        size_t first = t * queries / num_threads;  // not all in lockstep
+        for (size_t run = 0; run != runs; ++run) {
+            for (size_t q = 0; q != queries; ++q) {
+                size_t i = (first + q) % queries;
+                auto br = sp.get_bytes(base_addr, offsets[i], offsets[i + 1]);
+                auto start = std::chrono::steady_clock::now();
+                uint64_t count = m.lookup(br, adaptor);
+                essentials::do_not_optimize_away(count);
+                auto stop = std::chrono::steady_clock::now();
+                l.push_back(std::chrono::duration_cast<
+                                std::chrono::nanoseconds>(stop - start)
+                                .count());
+            }
         }
-    }
+    });
     timer.stop();
+
+    std::vector<uint32_t> all;
+    all.reserve(num_threads * queries * runs);
+    for (auto const& l : latencies) all.insert(all.end(), l.begin(), l.end());
+    std::sort(all.begin(), all.end());
+    double sum = std::accumulate(all.begin(), all.end(), 0.0);
+    auto percentile = [&](double p) {
+        return all[std::min<size_t>(all.size() - 1, p * all.size())] / 1000.0;
+    };
     double elapsed = timer.elapsed();
-    std::cout << "\tMean per run: " << elapsed / (1000000 * runs) << " [sec]"
-              << std::endl;
-    std::cout << "\tMean per query: " << elapsed / (queries * runs)
+    std::cout << "\tThroughput: " << all.size() / (elapsed / 1000000)
+              << " [queries/sec]" << std::endl;
+    std::cout << "\tMean per query: " << sum / (all.size() * 1000)
               << " [musec]" << std::endl;
+    std::cout << "\tLatency percentiles: 50% " << percentile(0.5)
+              << ", 99% " << percentile(0.99) << ", 99.9% "
+              << percentile(0.999) << " [musec]" << std::endl;
+    if (replicas) {
+        for (auto node : nodes) print_cache_stats(replicas->local(node));
+    } else {
+        print_cache_stats(model);
+    }
 }
 
 int main(int argc, char** argv) {
@@ -65,11 +171,51 @@ int main(int argc, char** argv) {
     parser.add("query_filename", "Query filename.");
     parser.add("runs",
                "Number of runs for the benchmark. Must be greater than 1.");
+    parser.add("huge_pages",
+               "Back the loaded data structure with huge pages.",
+               "--huge_pages", false, true);
+    parser.add("prefault",
+               "Number of threads faulting in the memory of the data "
+               "structure while it is loaded.",
+               "--prefault", false);
+    parser.add("mlock", "Lock the loaded data structure in memory.",
+               "--mlock", false, true);
+    parser.add("load_threads",
+               "Number of threads loading the sections of the data "
+               "structure (e.g., the orders of a trie) in parallel.",
+               "--load_threads", false);
+    parser.add("threads",
+               "Number of threads performing the lookups, pinned to the "
+               "NUMA nodes in round-robin order. Per-query latencies are "
+               "reported.",
+               "--t", false);
+    parser.add("numa",
+               "NUMA mode with --t: either 'replicate', i.e., a copy of the "
+               "data structure per node, or 'interleave', i.e., a single copy "
+               "interleaved among the nodes. Default to none.",
+               "--numa", false);
+    parser.add("max_order",
+               "Load the data structure up to this order: the grams of "
+               "higher order are reported as not found.",
+               "--max_order", false);
+    parser.add("cache",
+               "Number of slots of a cache of the most recent results, "
+               "shared by the threads, rounded up to a power of 2. Valid "
+               "for tries.",
+               "--cache", false);
     if (!parser.parse()) return 1;
 
     auto index_filename = parser.get<std::string>("index_filename");
     auto query_filename = parser.get<std::string>("query_filename");
     auto runs = parser.get<uint64_t>("runs");
+    memory::policy.huge_pages = parser.parsed("huge_pages");
+    memory::policy.lock = parser.parsed("mlock");
+    if (parser.parsed("prefault")) {
+        memory::policy.prefault_threads = parser.get<uint64_t>("prefault");
+    }
+    if (parser.parsed("load_threads")) {
+        memory::policy.load_threads = parser.get<uint64_t>("load_threads");
+    }
 
     if (runs == 0) {
         std::cerr << "Error: number of runs must be greater than 0."
@@ -77,13 +223,48 @@ int main(int argc, char** argv) {
         return 1;
     }
 
+    uint64_t num_threads = 0;  // 0 for the single-threaded benchmark
+    if (parser.parsed("threads")) {
+        num_threads = parser.get<uint64_t>("threads");
+        if (num_threads == 0) {
+            std::cerr << "Error: number of threads must be greater than 0."
+                      << std::endl;
+            return 1;
+        }
+    }
+    std::string numa_mode = "none";
+    if (parser.parsed("numa")) {
+        numa_mode = parser.get<std::string>("numa");
+        if (numa_mode != "replicate" and numa_mode != "interleave") {
+            std::cerr << "Error: NUMA mode must be either 'replicate' or "
+                         "'interleave'."
+                      << std::endl;
+            return 1;
+        }
+        if (!num_threads) num_threads = numa::nodes().size();
+    }
+
+    uint64_t max_order = global::max_order;
+    if (parser.parsed("max_order")) {
+        max_order = parser.get<uint64_t>("max_order");
+        if (max_order == 0) {
+            std::cerr << "Error: max_order must be greater than 0."
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    uint64_t cache_slots = 0;
+    if (parser.parsed("cache")) cache_slots = parser.get<uint64_t>("cache");
+
     auto model_string_type = util::get_model_type(index_filename);
 
     if (false) {
-#define LOOP_BODY(R, DATA, T)                              \
-    }                                                      \
-    else if (model_string_type == BOOST_PP_STRINGIZE(T)) { \
-        perf_test<T>(index_filename, query_filename, runs);
+#define LOOP_BODY(R, DATA, T)                                        \
+    }                                                                \
+    else if (model_string_type == BOOST_PP_STRINGIZE(T)) {           \
+        perf_test<T>(index_filename, query_filename, runs, num_threads, \
+                     numa_mode, max_order, cache_slots);
 
         BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, TONGRAMS_COUNT_TYPES);
 #undef LOOP_BODY
@@ -11,12 +11,9 @@
 
 using namespace tongrams;
 
-template <typename Model>
-void score_corpus(std::string const& index_filename,
+template <typename Model, typename State>
+void score_corpus(Model& model, State state,
                   std::string const& corpus_filename) {
-    Model model;
-    essentials::logger("Loading data structure");
-    util::load(model, index_filename);
     text_lines corpus(corpus_filename.c_str());
 
     uint64_t tot_OOVs = 0;
@@ -24,7 +21,6 @@ void score_corpus(std::string const& index_filename,
     float tot_log10_prob = 0.0;
     float tot_log10_prob_only_OOVs = 0.0;
 
-    auto state = model.state();
     essentials::logger("Scoring");
 
     essentials::timer_type timer;
@@ -83,21 +79,86 @@ void score_corpus(std::string const& index_filename,
               << std::endl;
 }
 
+template <typename Model>
+void score_corpus(std::string const& index_filename,
+                  std::string const& corpus_filename, uint64_t cache_slots) {
+    Model model;
+    essentials::logger("Loading data structure");
+    util::load(model, index_filename);
+    if (cache_slots) {
+        if constexpr (has_result_cache<Model>::value) {
+            model.set_cache(cache_slots);
+        } else {
+            std::cerr << "warning: option '--cache' ignored with this data "
+                         "structure type."
+                      << std::endl;
+        }
+    }
+    // NOTE: score() is specialized for the most common orders
+    switch (model.order()) {
+        case 3:
+            score_corpus(model, model.template state<3>(), corpus_filename);
+            break;
+        case 4:
+            score_corpus(model, model.template state<4>(), corpus_filename);
+            break;
+        case 5:
+            score_corpus(model, model.template state<5>(), corpus_filename);
+            break;
+        default:
+            score_corpus(model, model.state(), corpus_filename);
+    }
+    if constexpr (has_result_cache<Model>::value) {
+        if (auto cache = model.cache()) {
+            std::cout << "cache hit rate = " << cache->hit_rate() << " ("
+                      << cache->num_slots() << " slots, " << cache->bytes()
+                      << " bytes)" << std::endl;
+        }
+    }
+}
+
 int main(int argc, char** argv) {
     cmd_line_parser::parser parser(argc, argv);
     parser.add("index_filename", "Index filename.");
     parser.add("corpus_filename", "Corpus filename.");
+    parser.add("huge_pages",
+               "Back the loaded data structure with huge pages.",
+               "--huge_pages", false, true);
+    parser.add("prefault",
+               "Number of threads faulting in the memory of the data "
+               "structure while it is loaded.",
+               "--prefault", false);
+    parser.add("mlock", "Lock the loaded data structure in memory.",
+               "--mlock", false, true);
+    parser.add("load_threads",
+               "Number of threads loading the sections of the data "
+               "structure (e.g., the orders of a trie) in parallel.",
+               "--load_threads", false);
+    parser.add("cache",
+               "Number of slots of a cache of the most recent results, "
+               "rounded up to a power of 2. Valid for tries.",
+               "--cache", false);
     if (!parser.parse()) return 1;
 
     auto index_filename = parser.get<std::string>("index_filename");
     auto corpus_filename = parser.get<std::string>("corpus_filename");
+    memory::policy.huge_pages = parser.parsed("huge_pages");
+    memory::policy.lock = parser.parsed("mlock");
+    if (parser.parsed("prefault")) {
+        memory::policy.prefault_threads = parser.get<uint64_t>("prefault");
+    }
+    if (parser.parsed("load_threads")) {
+        memory::policy.load_threads = parser.get<uint64_t>("load_threads");
+    }
+    uint64_t cache_slots = 0;
+    if (parser.parsed("cache")) cache_slots = parser.get<uint64_t>("cache");
     auto model_string_type = util::get_model_type(index_filename);
 
     if (false) {
 #define LOOP_BODY(R, DATA, T)                              \
     }                                                      \
     else if (model_string_type == BOOST_PP_STRINGIZE(T)) { \
-        score_corpus<T>(index_filename, corpus_filename);
+        score_corpus<T>(index_filename, corpus_filename, cache_slots);
 
         BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, TONGRAMS_SCORE_TYPES);
 #undef LOOP_BODY
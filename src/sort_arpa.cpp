@@ -18,6 +18,10 @@ int main(int argc, char** argv) {
     parser.add("tmp_dir", "Temporary directory for sorting.", "--tmp", false);
     parser.add("ram", "Percentage of RAM to use. It must be in (0,100].",
                "--ram", false);
+    parser.add("freq_vocab",
+               "Assign word ids by descending count in the vocabulary file, "
+               "instead of by their order in the file.",
+               "--freq_vocab", false, true);
     if (!parser.parse()) return 1;
 
     auto order = parser.get<uint32_t>("order");
@@ -52,7 +56,8 @@ int main(int argc, char** argv) {
 
         single_valued_mpht64 vocab;
         essentials::logger("Building vocabulary");
-        build_vocabulary(vocab_filename.c_str(), vocab, available_ram * 0.8);
+        build_vocabulary(vocab_filename.c_str(), vocab, available_ram * 0.8,
+                         parser.parsed("freq_vocab"));
 
         ap.read_line();
 
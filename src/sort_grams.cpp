@@ -1,4 +1,5 @@
 #include <unistd.h>
+#include <thread>
 
 #include "sorters/sorter.hpp"
 #include "sorters/sorter_common.hpp"
@@ -33,12 +34,41 @@ int main(int argc, char** argv) {
     parser.add("tmp_dir", "Temporary directory for sorting.", "--tmp", false);
     parser.add("ram", "Percentage of RAM to use. It must be in (0,100].",
                "--ram", false);
+    parser.add("freq_vocab",
+               "Assign word ids by descending count in the vocabulary file, "
+               "instead of by their order in the file.",
+               "--freq_vocab", false, true);
+    parser.add("threads",
+               "Number of threads used to gzip the output. By default, all "
+               "available hardware threads are used. The output is compressed "
+               "only if output_filename ends with '.gz'.",
+               "--threads", false);
+    parser.add("histogram",
+               "Also write the histogram of distinct counts to "
+               "output_filename.hist, so that builders can skip their "
+               "counting pass.",
+               "--hist", false, true);
     if (!parser.parse()) return 1;
 
     auto ngrams_filename = parser.get<std::string>("ngrams_filename");
     auto vocab_filename = parser.get<std::string>("vocab_filename");
     auto output_filename = parser.get<std::string>("output_filename");
 
+    uint64_t compression_threads = 0;
+    std::string const gz(".gz");
+    if (output_filename.size() > gz.size() and
+        output_filename.compare(output_filename.size() - gz.size(), gz.size(),
+                                gz) == 0) {
+        compression_threads = std::thread::hardware_concurrency();
+        if (parser.parsed("threads")) {
+            compression_threads = parser.get<uint64_t>("threads");
+        }
+        if (!compression_threads) compression_threads = 1;
+    }
+
+    bool histogram = parser.parsed("histogram");
+    std::unordered_map<uint64_t, uint64_t> distinct_counts;
+
     std::string default_tmp_dir("./");
     std::string tmp_dir = default_tmp_dir;
     if (parser.parsed("tmp_dir")) {
@@ -57,7 +87,8 @@ int main(int argc, char** argv) {
 
     single_valued_mpht64 vocab;
     essentials::logger("Building vocabulary");
-    build_vocabulary(vocab_filename.c_str(), vocab, available_ram * 0.8);
+    build_vocabulary(vocab_filename.c_str(), vocab, available_ram * 0.8,
+                     parser.parsed("freq_vocab"));
 
     grams_gzparser input(ngrams_filename.c_str());
     auto n = input.num_lines();
@@ -70,7 +101,7 @@ int main(int argc, char** argv) {
     comparator_type cmp(vocab);
     {
         sorter<comparator_type, count_line_handler> sorter(
-            n, cmp, output_filename, tmp_dir);
+            n, cmp, output_filename, tmp_dir, compression_threads);
 
         for (uint64_t i = 0; i < n - 1;) {
             auto const& l = *begin;
@@ -87,12 +118,30 @@ int main(int argc, char** argv) {
             }
 
             auto& grams_index = gp.index();
+            if (histogram) {
+                for (auto const& record : grams_index) {
+                    ++distinct_counts[record.count];
+                }
+            }
             sorter.sort(grams_index.begin(), grams_index.end());
             gp.clear();
             ++i;
         }
     }
 
+    if (histogram) {
+        essentials::logger("Writing counts histogram");
+        std::vector<std::pair<uint64_t, uint64_t>> sorted(
+            distinct_counts.begin(), distinct_counts.end());
+        std::sort(sorted.begin(), sorted.end());
+        std::string histogram_filename;
+        util::histogram_filename(output_filename, histogram_filename);
+        std::ofstream os(histogram_filename.c_str());
+        os << sorted.size() << '\n';
+        for (auto const& p : sorted) os << p.first << '\t' << p.second << '\n';
+        os.close();
+    }
+
     if (tmp_dir != default_tmp_dir) {
         if (!essentials::remove_directory(tmp_dir)) {
             std::cerr << "directory '" << tmp_dir << "' not removed"
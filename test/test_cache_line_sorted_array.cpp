@@ -0,0 +1,108 @@
+#include <iostream>
+
+#include "utils/util.hpp"
+#include "vectors/cache_line_sorted_array.hpp"
+#include "sequences/indexed_codewords_sequence.hpp"
+#include "../external/essentials/include/essentials.hpp"
+#include "../external/cmd_line_parser/include/parser.hpp"
+
+using namespace tongrams;
+
+typedef sorted_array<cache_line_layout, indexed_codewords_sequence,
+                     indexed_codewords_sequence>
+    sorted_array_type;
+
+// the largest value of the given width, but global::not_found
+uint64_t max_value(uint64_t width) {
+    return width == 64 ? global::not_found - 1
+                       : (uint64_t(1) << width) - 1;
+}
+
+// NOTE: the grams are split into ranges of increasing ids, as the
+// children of the grams of a trie level; the largest id and rank are
+// those of the last gram, so that they end the last block
+void check(uint64_t n, uint64_t id_width, uint64_t rank_width,
+           bool with_pointers) {
+    std::cout << "id width " << id_width << ", rank width " << rank_width
+              << (with_pointers ? ", with pointers" : "") << std::endl;
+
+    std::mt19937_64 rng(essentials::get_random_seed());
+    std::uniform_int_distribution<uint64_t> range_distr(
+        1, std::min<uint64_t>(20, max_value(id_width) + 1));
+    std::uniform_int_distribution<uint64_t> rank_distr(
+        0, max_value(rank_width));
+    std::vector<pointer_range> ranges;
+    std::vector<uint64_t> ids;
+    std::vector<uint64_t> ranks;
+    for (uint64_t begin = 0; begin < n;) {
+        uint64_t end = std::min<uint64_t>(begin + range_distr(rng), n);
+        ranges.push_back({begin, end});
+        // distinct ids spread over the whole width
+        std::uniform_int_distribution<uint64_t> id_distr(
+            0, max_value(id_width) - (end - begin) + 1);
+        std::vector<uint64_t> r(end - begin);
+        for (auto& x : r) x = id_distr(rng);
+        std::sort(r.begin(), r.end());
+        for (uint64_t i = 0; i != r.size(); ++i) {
+            ids.push_back(r[i] + i);
+            ranks.push_back(rank_distr(rng));
+        }
+        begin = end;
+    }
+    ids.back() = max_value(id_width);
+    ranks.back() = max_value(rank_width);
+
+    sorted_array_type::builder builder(n, ids.back(), ranks.back(), 1);
+    for (uint64_t pos = 0; pos != n; ++pos) {
+        builder.add_gram(ids[pos]);
+        builder.add_count_rank(ranks[pos]);
+    }
+    sorted_array_type sa(n);
+    std::vector<uint64_t> pointers;
+    builder.build(sa, pointers, 2, value_type::count);
+    if (with_pointers) {
+        std::uniform_int_distribution<uint64_t> children_distr(0, 3);
+        pointers.push_back(0);
+        for (uint64_t pos = 0; pos != n; ++pos) {
+            pointers.push_back(pointers.back() + children_distr(rng));
+        }
+        sorted_array_type::builder::build_pointers(sa, pointers);
+    }
+    std::cout << "\t" << sa.grams_per_block() << " grams per block"
+              << std::endl;
+
+    for (auto const& r : ranges) {
+        for (uint64_t pos = r.begin; pos != r.end; ++pos) {
+            util::check(pos, sa.position(r, ids[pos]), pos, "position");
+            util::check(pos, sa.count_rank(pos), ranks[pos], "rank");
+            if (with_pointers) {
+                pointer_range children = sa.range(pos);
+                util::check(pos, children.begin, pointers[pos], "begin");
+                util::check(pos, children.end, pointers[pos + 1], "end");
+            }
+        }
+    }
+    essentials::logger("OK");
+}
+
+int main(int argc, char** argv) {
+    cmd_line_parser::parser parser(argc, argv);
+    parser.add("num_of_grams", "Number of grams.");
+    if (!parser.parse()) return 1;
+
+    uint64_t n = parser.get<uint64_t>("num_of_grams");
+    if (n == 0) {
+        std::cerr << "Argument must be non zero." << std::endl;
+        return 1;
+    }
+
+    uint64_t widths[][2] = {{64, 64}, {64, 1}, {1, 64}, {63, 64},
+                            {64, 63}, {33, 31}, {7, 13}};
+    for (auto const& w : widths) {
+        for (bool with_pointers : {false, true}) {
+            check(n, w[0], w[1], with_pointers);
+        }
+    }
+
+    return 0;
+}
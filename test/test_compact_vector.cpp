@@ -1,12 +1,45 @@
 #include <iostream>
 
 #include "utils/util.hpp"
+#include "vectors/bit_vector.hpp"
 #include "vectors/compact_vector.hpp"
 #include "../external/essentials/include/essentials.hpp"
 #include "../external/cmd_line_parser/include/parser.hpp"
 
+using namespace tongrams;
+
+// get<Width>() must match operator[] for all the widths from Width to 64,
+// those read with aligned loads (8, 16, 32 and 64) and the others
+template <uint64_t Width>
+void check_get(uint64_t n, std::mt19937_64& rng) {
+    uint64_t max = Width == 64 ? uint64_t(-1) : (uint64_t(1) << Width) - 1;
+    std::uniform_int_distribution<uint64_t> distr(0, max);
+    std::vector<uint64_t> v;
+    v.reserve(n);
+    compact_vector::builder cvb(n, Width);
+    for (uint64_t i = 0; i < n; ++i) {
+        v.push_back(i + 1 == n ? max : distr(rng));  // all the bits set last
+        cvb.push_back(v.back());
+    }
+    compact_vector values(cvb);
+    for (uint64_t i = 0; i < n; ++i) {
+        util::check(i, values.get<Width>(i), v[i], "value");
+        util::check(i, values.get<Width>(i), values[i], "value");
+    }
+    if constexpr (Width < 64) check_get<Width + 1>(n, rng);
+}
+
+// get_bits<Len>() must match get_bits(pos, Len) at every position,
+// including those whose bits span two words
+template <uint64_t Len>
+void check_get_bits(bit_vector const& bv) {
+    for (uint64_t pos = 0; pos + Len <= bv.size(); ++pos) {
+        util::check(pos, bv.get_bits<Len>(pos), bv.get_bits(pos, Len),
+                    "bits");
+    }
+}
+
 int main(int argc, char** argv) {
-    using namespace tongrams;
     cmd_line_parser::parser parser(argc, argv);
     parser.add("num_of_values", "Number of values.");
     parser.add("bits_per_value", "Bits per value.");
@@ -92,5 +125,23 @@ int main(int argc, char** argv) {
     essentials::logger("OK");
     std::remove("./tmp.out");
 
+    std::mt19937_64 rng(essentials::get_random_seed());
+    essentials::logger("Checking get<Width>() for widths 1 to 64");
+    check_get<1>(n, rng);
+    essentials::logger("OK");
+
+    essentials::logger("Checking bit_vector::get_bits<Len>()");
+    bit_vector_builder bvb;
+    for (uint64_t i = 0; i < n; ++i) bvb.append_bits(rng(), 64);
+    bit_vector bv(&bvb);
+    check_get_bits<1>(bv);
+    check_get_bits<7>(bv);
+    check_get_bits<8>(bv);
+    check_get_bits<32>(bv);
+    check_get_bits<33>(bv);
+    check_get_bits<63>(bv);
+    check_get_bits<64>(bv);
+    essentials::logger("OK");
+
     return 0;
 }
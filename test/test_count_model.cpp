@@ -29,16 +29,95 @@ void check_model(Model& model, std::string const& input_folder) {
         }
         essentials::logger("OK");
     }
+
+    // the grams of the first order not loaded, if any
+    std::string filename = input_folder + "/" +
+                           std::to_string(model.order() + 1) +
+                           "-grams.sorted.gz";
+    if (model.order() < global::max_order and std::ifstream(filename).good()) {
+        tongrams::grams_gzparser grams_parser(filename.c_str());
+        essentials::logger("Checking that higher-order grams are not found");
+        uint64_t i = 0;
+        for (auto const& l : grams_parser) {
+            util::check(i, model.lookup(l.gram, adaptor), global::not_found,
+                        "value");
+            ++i;
+        }
+        essentials::logger("OK");
+    }
+
+    // NOTE: a model that keeps fingerprints of the grams (e.g., built
+    // with --k) can find absent grams, that are then only counted
+    std::ifstream not_found_queries(input_folder + "/queries.not_found");
+    if (not_found_queries.good()) {
+        essentials::logger("Checking that absent grams are not found");
+        stl_string_adaptor string_adaptor;
+        double false_positive_rate = model.false_positive_rate();
+        uint64_t false_positives = 0;
+        std::string query;
+        uint64_t i = 0;
+        for (; std::getline(not_found_queries, query); ++i) {
+            uint64_t count = model.lookup(query, string_adaptor);
+            if (false_positive_rate == 0.0) {
+                util::check(i, count, global::not_found, "value");
+            } else if (count != global::not_found) {
+                ++false_positives;
+            }
+        }
+        if (false_positive_rate > 0.0) {
+            std::cout << "	" << false_positives << "/" << i
+                      << " absent grams found (expected false positive "
+                         "rate: "
+                      << false_positive_rate << ")" << std::endl;
+        }
+        essentials::logger("OK");
+    }
+}
+
+// NOTE: the model is also checked when loaded up to the orders that can
+// be remapped: the queries of more words than the loaded orders must be
+// reported as not found, without remapping their ids. The same object is
+// loaded again, with a cache if it has one, so that a result cached for
+// a previous load would not match
+template <typename Model>
+void check_truncated_model(Model& model, std::string const& binary_filename,
+                           std::string const& input_folder) {
+    uint64_t max_orders = std::min<uint64_t>(model.order() - 1,
+                                             global::max_remapping_order);
+    if constexpr (has_result_cache<Model>::value) {
+        if (max_orders) {
+            essentials::logger("Filling a cache of the data structure");
+            model.set_cache(uint64_t(1) << 20);
+            check_model<Model>(model, input_folder);
+        }
+    }
+    for (uint64_t max_order = 1; max_order <= max_orders; ++max_order) {
+        essentials::logger("Loading data structure up to order " +
+                           std::to_string(max_order));
+        util::load(model, binary_filename.c_str(), max_order);
+        check_model<Model>(model, input_folder);
+    }
 }
 
 int main(int argc, char** argv) {
     cmd_line_parser::parser parser(argc, argv);
     parser.add("binary_filename", "Binary filename.");
     parser.add("input_folder", "Input folder.");
+    parser.add("max_order", "Load the model up to this order.", "--max_order",
+               false);
+    parser.add("load_threads",
+               "Number of threads loading the sections of the model.",
+               "--load_threads", false);
     if (!parser.parse()) return 1;
 
     auto binary_filename = parser.get<std::string>("binary_filename");
     auto input_folder = parser.get<std::string>("input_folder");
+    uint64_t max_order = parser.parsed("max_order")
+                             ? parser.get<uint64_t>("max_order")
+                             : global::max_order;
+    if (parser.parsed("load_threads")) {
+        memory::policy.load_threads = parser.get<uint64_t>("load_threads");
+    }
     auto model_string_type = util::get_model_type(binary_filename.c_str());
 
     if (false) {
@@ -47,12 +126,16 @@ int main(int argc, char** argv) {
     else if (model_string_type == BOOST_PP_STRINGIZE(T)) {                    \
         T model;                                                              \
         essentials::logger("Loading data structure");                         \
-        size_t file_size = util::load(model, binary_filename.c_str());        \
+        size_t file_size =                                                    \
+            util::load(model, binary_filename.c_str(), max_order);            \
         std::cout << "\tTotal bytes: " << file_size << "\n";                  \
         std::cout << "\tTotal ngrams: " << model.size() << "\n";              \
         std::cout << "\tBytes per gram: " << double(file_size) / model.size() \
                   << std::endl;                                               \
-        check_model<T>(model, input_folder);
+        check_model<T>(model, input_folder);                                  \
+        if (!parser.parsed("max_order")) {                                    \
+            check_truncated_model<T>(model, binary_filename, input_folder);   \
+        }
 
         BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, TONGRAMS_COUNT_TYPES);
 #undef LOOP_BODY
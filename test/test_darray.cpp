@@ -0,0 +1,63 @@
+#include <iostream>
+
+#include "utils/util.hpp"
+#include "sequences/darray.hpp"
+#include "../external/essentials/include/essentials.hpp"
+#include "../external/cmd_line_parser/include/parser.hpp"
+
+using namespace tongrams;
+
+template <typename Darray>
+void test(bit_vector const& bv, std::vector<uint64_t> const& positions,
+          uint64_t num_threads) {
+    Darray d(bv, num_threads);
+    util::check(0, d.num_positions(), positions.size(), "number of positions");
+    for (uint64_t i = 0; i != positions.size(); ++i) {
+        util::check(i, d.select(bv, i), positions[i], "position");
+    }
+}
+
+int main(int argc, char** argv) {
+    cmd_line_parser::parser parser(argc, argv);
+    parser.add("num_of_bits", "Number of bits.");
+    parser.add("density", "Density of ones. It must be in (0,1).");
+    parser.add("num_threads", "Number of threads used to build the index.");
+    if (!parser.parse()) return 1;
+
+    uint64_t n = parser.get<uint64_t>("num_of_bits");
+    double density = parser.get<double>("density");
+    uint64_t num_threads = parser.get<uint64_t>("num_threads");
+    if (n == 0 or density <= 0.0 or density >= 1.0 or num_threads == 0) {
+        std::cerr << "invalid arguments." << std::endl;
+        return 1;
+    }
+
+    // NOTE: alternate dense and sparse regions, so that
+    // both dense and overflow blocks are exercised
+    essentials::uniform_int_rng<uint64_t> distr(0, 1000000,
+                                                essentials::get_random_seed());
+    bit_vector_builder bvb(n);
+    std::vector<uint64_t> ones;
+    std::vector<uint64_t> zeros;
+    uint64_t region = n / 8 + 1;
+    for (uint64_t i = 0; i != n; ++i) {
+        double d = (i / region) % 2 ? density / 100 : density;
+        if (distr.gen() < d * 1000000) {
+            bvb.set(i, 1);
+            ones.push_back(i);
+        } else {
+            zeros.push_back(i);
+        }
+    }
+    bit_vector bv(&bvb);
+
+    essentials::logger("Testing darray1");
+    test<darray1>(bv, ones, num_threads);
+    essentials::logger("OK");
+
+    essentials::logger("Testing darray0");
+    test<darray0>(bv, zeros, num_threads);
+    essentials::logger("OK");
+
+    return 0;
+}
@@ -30,13 +30,21 @@ int main(int argc, char** argv) {
     essentials::uniform_int_rng<uint64_t> value_distr(
         1,  // elements are distinct within a range
         50, essentials::get_random_seed());
+    // NOTE: some ranges are long enough to be searched with the B-tree
+    // of fast_ef_sequence, whose height grows with their length
+    essentials::uniform_int_rng<uint64_t> long_range_distr(
+        fast_ef_sequence::sampling_threshold,
+        256 * fast_ef_sequence::sampling_threshold,
+        essentials::get_random_seed());
 
     std::vector<uint64_t> pointers;
     pointers.push_back(0);
     std::vector<pointer_range> pointer_ranges;
     uint64_t last_offset = 0;
     for (uint64_t offset = 0; offset < n;) {
-        uint64_t range = range_distr.gen();
+        uint64_t range = pointer_ranges.size() % 1024 == 1
+                             ? long_range_distr.gen()
+                             : range_distr.gen();
         offset += range;
         if (offset > n) {
             offset = n;
@@ -97,5 +105,26 @@ int main(int argc, char** argv) {
     assert(j == pointer_ranges.size() - 1);
     essentials::logger("OK");
 
+    essentials::logger("Testing fast_ef_sequence::find() of absent values");
+    uint64_t long_ranges = 0;
+    for (auto const& ptr_range : pointer_ranges) {
+        if (ptr_range.end - ptr_range.begin >=
+            fast_ef_sequence::sampling_threshold) {
+            ++long_ranges;
+        }
+        // the values between two consecutive values and after the last one
+        for (uint64_t i = ptr_range.begin; i < ptr_range.end; ++i) {
+            uint64_t next = i + 1 < ptr_range.end ? values[i + 1]
+                                                  : values[i] + 2;
+            if (next == values[i] + 1) continue;
+            uint64_t pos = 0;
+            seq.find(ptr_range, values[i] + 1, &pos);
+            util::check(i, pos, global::not_found, "position");
+        }
+    }
+    std::cout << "number of ranges searched with the B-tree: " << long_ranges
+              << std::endl;
+    essentials::logger("OK");
+
     return 0;
 }
@@ -8,21 +8,22 @@
 using namespace tongrams;
 
 template <typename HashType>
-void perf_test(uint64_t n, uint64_t w) {
+void perf_test(uint64_t n, uint64_t w, uint64_t key_bits) {
     typedef HashType hash_t;
     std::vector<hash_t> keys;
     std::vector<uint64_t> values;
     keys.reserve(n);
     values.reserve(n);
 
-    typename hash_compact_vector<hash_t>::builder hcvb(n, w);
+    typename hash_compact_vector<hash_t>::builder hcvb(n, w, key_bits);
+    hash_t key_mask = hash_compact_vector<hash_t>::key_mask(key_bits);
     essentials::uniform_int_rng<uint64_t> distr(0, std::pow(2, w - 1),
                                                 essentials::get_random_seed());
     essentials::logger("Generating random (key, value) pairs");
     for (uint64_t i = 0; i < n; ++i) {
         hash_t k = distr.gen();
         uint64_t v = distr.gen();
-        keys.push_back(k);
+        keys.push_back(k & key_mask);
         values.push_back(v);
         hcvb.set(i, k, v);
     }
@@ -61,6 +62,9 @@ int main(int argc, char** argv) {
     parser.add("bits_per_hash",
                "Bits per hash key. It must be either 32 or 64.");
     parser.add("bits_per_value", "Bits per value.");
+    parser.add("key_bits",
+               "Bits kept per hash key. Default to bits_per_hash.", "--k",
+               false);
     if (!parser.parse()) return 1;
 
     uint64_t n = parser.get<uint64_t>("num_of_values");
@@ -71,11 +75,15 @@ int main(int argc, char** argv) {
 
     uint64_t hash_width = parser.get<uint64_t>("bits_per_hash");
     uint64_t w = parser.get<uint64_t>("bits_per_value");
+    uint64_t key_bits = hash_width;
+    if (parser.parsed("key_bits")) {
+        key_bits = parser.get<uint64_t>("key_bits");
+    }
 
     if (hash_width == 32) {
-        perf_test<uint32_t>(n, w);
+        perf_test<uint32_t>(n, w, key_bits);
     } else if (hash_width == 64) {
-        perf_test<uint64_t>(n, w);
+        perf_test<uint64_t>(n, w, key_bits);
     } else {
         std::cerr << "Error: hash width must be 32 or 64." << std::endl;
         std::terminate();
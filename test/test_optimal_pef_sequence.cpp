@@ -0,0 +1,225 @@
+#include <iostream>
+#include <thread>
+
+#include "utils/util.hpp"
+#include "sequences/optimal_pef_sequence.hpp"
+#include "../external/essentials/include/essentials.hpp"
+#include "../external/cmd_line_parser/include/parser.hpp"
+
+// NOTE: find(r, id) searches the value id + (the value preceding r.begin)
+// among the positions of r: the result must be its first position in r,
+// or not_found
+void check_find(pef::optimal_pef_sequence const& seq,
+                std::vector<uint64_t> const& absolute, uint64_t begin,
+                uint64_t end, uint64_t id) {
+    uint64_t value = id + (begin ? absolute[begin - 1] : 0);
+    auto it = std::lower_bound(absolute.begin() + begin,
+                               absolute.begin() + end, value);
+    uint64_t expected = it != absolute.begin() + end and *it == value
+                            ? uint64_t(it - absolute.begin())
+                            : tongrams::global::not_found;
+    uint64_t pos = 0;
+    seq.find({begin, end}, id, &pos);
+    tongrams::util::check(begin, pos, expected, "position");
+}
+
+int main(int argc, char** argv) {
+    using namespace tongrams;
+    cmd_line_parser::parser parser(argc, argv);
+    parser.add("num_of_values", "Number of values.");
+    parser.add("max_range_len", "Maximum range length.");
+    if (!parser.parse()) return 1;
+
+    uint64_t n = parser.get<uint64_t>("num_of_values");
+    uint64_t max_range_len = parser.get<uint64_t>("max_range_len");
+    if (n == 0 or max_range_len == 0) {
+        std::cerr << "Arguments must be both non zero." << std::endl;
+        std::terminate();
+    }
+
+    std::random_device rd;
+    std::mt19937 rng(rd());
+
+    {
+        essentials::uniform_int_rng<uint64_t> value_distr(
+            0,  // sequence is not strictly increasing
+            100, essentials::get_random_seed());
+
+        std::vector<uint64_t> values;
+        values.reserve(n);
+        uint64_t last_value = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+            values.push_back(last_value + value_distr.gen());
+            last_value = values.back();
+        }
+        assert(values.size() == n);
+
+        pef::optimal_pef_sequence seq;
+        essentials::logger("Building sequence");
+        seq.build(values.begin(), values.size(), values.back(), 2);
+
+        essentials::logger("Testing iterator");
+        auto it = seq.begin();
+        for (uint64_t i = 0; i < n; ++i) {
+            util::check(i, it.next(), values[i], "value");
+        }
+        essentials::logger("OK");
+
+        essentials::logger("Testing optimal_pef_sequence::operator[]()");
+        for (uint64_t i = 0; i < n; ++i) {
+            util::check(i, seq[i], values[i], "value");
+        }
+        essentials::logger("OK");
+    }
+
+    std::uniform_int_distribution<uint64_t> range_distr(1,  // not empty ranges
+                                                        max_range_len);
+
+    std::vector<uint64_t> pointers;
+    pointers.push_back(0);
+    std::vector<pointer_range> pointer_ranges;
+    uint64_t last_offset = 0;
+    for (uint64_t offset = 0; offset < n;) {
+        uint64_t range = range_distr(rng);
+        offset += range;
+        if (offset > n) {
+            offset = n;
+        }
+        pointers.push_back(offset);
+        pointer_ranges.push_back({last_offset, offset});
+        last_offset = offset;
+    }
+    assert(pointers.size() == pointer_ranges.size() + 1);
+    std::cout << "number of created ranges: " << pointer_ranges.size()
+              << std::endl;
+
+    // NOTE: runs of dense and of sparse values alternate every 1024
+    // positions, so that the sequence is cut into many partitions
+    std::uniform_int_distribution<uint64_t> dense_distr(1, 2);
+    std::uniform_int_distribution<uint64_t> sparse_distr(1, 5000);
+    auto gap = [&](uint64_t position) {  // elements are distinct in a range
+        return (position >> 10) & 1 ? sparse_distr(rng) : dense_distr(rng);
+    };
+
+    // NOTE: unlike uniform_pef_sequence, find() does not assume that
+    // id 0 is in every range, so half of the ranges do not begin with 0
+    std::vector<uint64_t> values;
+    values.reserve(n);
+    for (auto const& ptr_range : pointer_ranges) {
+        uint64_t last_value = rng() % 2 ? 0 : gap(ptr_range.begin);
+        values.push_back(last_value);
+        for (uint64_t k = ptr_range.begin + 1; k < ptr_range.end; ++k) {
+            values.push_back(last_value + gap(k));
+            last_value = values.back();
+        }
+    }
+    assert(values.size() == n);
+
+    pef::optimal_pef_sequence seq;
+    essentials::logger("Building sequence");
+    seq.build(values.begin(), values.size(), pointers, 2);
+
+    essentials::logger("Testing iterator");
+    auto it = seq.begin();
+    uint64_t j = 0;
+    for (uint64_t i = 0; i < n; ++i) {
+        auto ptr_range = pointer_ranges[j];
+        if (i >= ptr_range.end) {
+            ++j;
+            ptr_range = pointer_ranges[j];
+        }
+        uint64_t prev = ptr_range.begin ? seq[ptr_range.begin - 1] : 0;
+        util::check(i, it.next() - prev, values[i], "value");
+    }
+    assert(j == pointer_ranges.size() - 1);
+    essentials::logger("OK");
+
+    essentials::logger("Testing optimal_pef_sequence::find()");
+    j = 0;
+    for (uint64_t i = 0; i < n; ++i) {
+        auto ptr_range = pointer_ranges[j];
+        if (i >= ptr_range.end) {
+            ++j;
+            ptr_range = pointer_ranges[j];
+        }
+        uint64_t pos = 0;
+        seq.find(ptr_range, values[i], &pos);
+        util::check(i, pos, i, "position");
+    }
+    assert(j == pointer_ranges.size() - 1);
+    essentials::logger("OK");
+
+    // the values of the sequence, without the ranges
+    std::vector<uint64_t> absolute;
+    absolute.reserve(n);
+    for (uint64_t i = 0; i < n; ++i) absolute.push_back(seq[i]);
+
+    essentials::logger("Testing absent values");
+    for (auto const& r : pointer_ranges) {
+        check_find(seq, absolute, r.begin, r.end, 0);
+        for (uint64_t i = r.begin; i + 1 < r.end; ++i) {  // gaps
+            check_find(seq, absolute, r.begin, r.end, values[i] + 1);
+        }
+        // NOTE: past the last value, the following range may hold the
+        // searched value, but not within this range
+        for (uint64_t k = 1; k <= 3; ++k) {
+            check_find(seq, absolute, r.begin, r.end, values[r.end - 1] + k);
+        }
+    }
+    essentials::logger("OK");
+
+    // NOTE: the ranges beginning or ending at a partition, or at a
+    // sampled position, are searched with the directory and the samples
+    std::vector<uint64_t> boundaries;
+    auto e = seq.begin();
+    for (uint64_t p = 0; p < n; p = e.m_cur_end) {
+        e.move(p);
+        boundaries.push_back(e.m_cur_begin);
+    }
+    std::cout << "number of partitions: " << boundaries.size() << std::endl;
+    const uint64_t sampling = uint64_t(1)
+                              << pef::optimal_pef_sequence::log_sampling;
+    for (uint64_t p = sampling; p < n; p += sampling) boundaries.push_back(p);
+    essentials::logger("Testing partition and sample boundaries");
+    for (uint64_t p : boundaries) {
+        // the ranges [p - k, p + l), for k and l up to 3
+        for (uint64_t k = 0; k <= std::min<uint64_t>(p, 3); ++k) {
+            for (uint64_t l = !k; l <= 3 and p + l <= n; ++l) {
+                uint64_t begin = p - k;
+                uint64_t end = p + l;
+                uint64_t prev = begin ? absolute[begin - 1] : 0;
+                for (uint64_t i = begin; i != end; ++i) {
+                    check_find(seq, absolute, begin, end, absolute[i] - prev);
+                    check_find(seq, absolute, begin, end,
+                               absolute[i] - prev + 1);
+                }
+            }
+        }
+    }
+    essentials::logger("OK");
+
+    // NOTE: the threads search the same sequence starting from
+    // different ranges, as the threads of lookup_perf_test --t do
+    const uint64_t num_threads = 8;
+    essentials::logger("Testing optimal_pef_sequence::find() with " +
+                       std::to_string(num_threads) + " threads");
+    std::vector<std::thread> threads;
+    for (uint64_t t = 0; t != num_threads; ++t) {
+        threads.emplace_back([&, t] {
+            uint64_t num_ranges = pointer_ranges.size();
+            uint64_t first = t * num_ranges / num_threads;
+            for (uint64_t k = 0; k != num_ranges; ++k) {
+                auto const& r = pointer_ranges[(first + k) % num_ranges];
+                for (uint64_t i = r.begin; i != r.end; ++i) {
+                    uint64_t pos = 0;
+                    seq.find(r, values[i], &pos);
+                    util::check(i, pos, i, "position");
+                }
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    essentials::logger("OK");
+
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include <iostream>
+
+#include "utils/util.hpp"
+#include "utils/iterators.hpp"
+#include "lm_types.hpp"
+#include "score.hpp"
+#include "../external/essentials/include/essentials.hpp"
+#include "../external/cmd_line_parser/include/parser.hpp"
+
+using namespace tongrams;
+
+// the scores of the decoder states must be those of score() on a corpus
+template <typename Model>
+void check_model(Model& model, std::string const& corpus_filename) {
+    text_lines corpus(corpus_filename.c_str());
+    auto state = model.state();
+    decoder_state in, out;
+    decoder_state other, other_out;  // see below
+    bool has_other = false;
+    std::vector<uint64_pair> words;  // of the sentence, up to the current
+    essentials::logger("Checking decoder states");
+    uint64_t i = 0;
+    while (!corpus.end_of_file()) {
+        state.init();
+        in = decoder_state();
+        has_other = false;
+        words.clear();
+        bool is_OOV = false;
+        corpus.begin_line();
+        while (!corpus.end_of_line()) {
+            auto word = corpus.next_word();
+            words.push_back(model.word(word));
+            float expected = model.score(state, word, is_OOV);
+            float got = model.score(in, words.back(), out);
+            if (got != expected) {
+                std::cout << "Error at word " << i << ": got " << got
+                          << ", but expected " << expected << std::endl;
+                std::abort();
+            }
+            util::check(i, out.length, state.length, "history length");
+            if (has_other and
+                (model.score(other, words.back(), other_out) != got or
+                 other_out != out)) {
+                std::cout << "Error at word " << i
+                          << ": a state of the same context scores "
+                          << "differently" << std::endl;
+                std::abort();
+            }
+
+            // NOTE: the context of out, reached from a shorter history
+            // (only its own words), must be the same state, and it is
+            // then checked to give the same score to the next word
+            has_other = words.size() > out.length;
+            if (has_other) {
+                other = decoder_state();
+                for (uint64_t j = words.size() - out.length;
+                     j != words.size(); ++j) {
+                    model.score(other, words[j], other_out);
+                    std::swap(other, other_out);
+                }
+                if (other != out or other.hash() != out.hash()) {
+                    std::cout << "Error at word " << i
+                              << ": states of the same context differ"
+                              << std::endl;
+                    std::abort();
+                }
+            }
+            std::swap(in, out);
+            ++i;
+        }
+    }
+    essentials::logger("OK");
+}
+
+int main(int argc, char** argv) {
+    cmd_line_parser::parser parser(argc, argv);
+    parser.add("binary_filename", "Binary filename.");
+    parser.add("corpus_filename", "Corpus filename.");
+    if (!parser.parse()) return 1;
+
+    auto binary_filename = parser.get<std::string>("binary_filename");
+    auto corpus_filename = parser.get<std::string>("corpus_filename");
+    auto model_string_type = util::get_model_type(binary_filename.c_str());
+
+    if (false) {
+#define LOOP_BODY(R, DATA, T)                              \
+    }                                                      \
+    else if (model_string_type == BOOST_PP_STRINGIZE(T)) { \
+        T model;                                           \
+        essentials::logger("Loading data structure");      \
+        util::load(model, binary_filename.c_str());        \
+        check_model<T>(model, corpus_filename);
+
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, TONGRAMS_TRIE_PROB_TYPES);
+#undef LOOP_BODY
+    } else {
+        std::cerr << "Error: check not supported with type "
+                  << "'" << model_string_type << "'." << std::endl;
+    }
+
+    return 0;
+}
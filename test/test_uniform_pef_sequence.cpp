@@ -1,4 +1,5 @@
 #include <iostream>
+#include <thread>
 
 #include "utils/util.hpp"
 #include "sequences/uniform_pef_sequence.hpp"
@@ -128,5 +129,28 @@ int main(int argc, char** argv) {
     assert(j == pointer_ranges.size() - 1);
     essentials::logger("OK");
 
+    // NOTE: the threads search the same sequence starting from
+    // different ranges, as the threads of lookup_perf_test --t do
+    const uint64_t num_threads = 8;
+    essentials::logger("Testing uniform_pef_sequence::find() with " +
+                       std::to_string(num_threads) + " threads");
+    std::vector<std::thread> threads;
+    for (uint64_t t = 0; t != num_threads; ++t) {
+        threads.emplace_back([&, t] {
+            uint64_t num_ranges = pointer_ranges.size();
+            uint64_t first = t * num_ranges / num_threads;
+            for (uint64_t k = 0; k != num_ranges; ++k) {
+                auto const& r = pointer_ranges[(first + k) % num_ranges];
+                for (uint64_t i = r.begin; i != r.end; ++i) {
+                    uint64_t pos = 0;
+                    seq.find(r, values[i], &pos);
+                    util::check(i, pos, i, "position");
+                }
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    essentials::logger("OK");
+
     return 0;
 }